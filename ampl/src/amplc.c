@@ -16,12 +16,17 @@
 
 /* TODO: Include the appropriate system and project header files */
 
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "scanner.h"
+#include "tokenstream.h"
 #include "valtypes.h"
 #include "symboltable.h"
 #include "hashtable.h"
+#include "intern.h"
 #include "errmsg.h"
 #include "error.h"
 #include "boolean.h"
@@ -70,11 +75,14 @@ void debug_info(const char *fmt, ...);
 
 Token    token;       /**< the lookahead token.type                */
 FILE    *src_file;    /**< the source code file                    */
+Scanner *scanner;     /**< the scanner over the source code file   */
 char    *class_name;  /**< the name of the compiled JVM class file */
 ValType  return_type; /**< the return type of the current function */
 int is_assign;
 int stack_depth, max_stack_depth;
 int is_if_or_while = 0;
+TokenStream  *token_stream; /**< the pre-scanned tokens, or NULL    */
+unsigned int  token_index;  /**< the index of the lookahead token   */
 
 /* TODO: Uncomment the previous definition for use during type checking. */
 /* DONE */
@@ -106,6 +114,7 @@ void reset_offset(void);
 void set_max_stack_depth(int max_depth);
 int return_curr_offset(void);
 void inc_stack_depth(void);
+void next_token(void);
 
 /* --- helper macros -------------------------------------------------------- */
 
@@ -158,6 +167,7 @@ void abort_compile_pos(SourcePos *posp, Error err, ...);
 int main(int argc, char *argv[])
 {
 	char *jasmin_path;
+	int opt, prescan = 0, stats = 0;
 
 	/* TODO: Uncomment the previous definition for code generation. */
 
@@ -167,8 +177,20 @@ int main(int argc, char *argv[])
 	max_stack_depth = 0;
 
 	/* check command-line arguments and environment */
-	if (argc != 2) {
-		eprintf("Usage: %s <filename>", getprogname());
+	while ((opt = getopt(argc, argv, "ps")) != -1) {
+		switch (opt) {
+			case 'p':
+				prescan = 1;
+				break;
+			case 's':
+				stats = 1;
+				break;
+			default:
+				eprintf("Usage: %s [-p] [-s] <filename | ->", getprogname());
+		}
+	}
+	if (argc - optind != 1) {
+		eprintf("Usage: %s [-p] [-s] <filename | ->", getprogname());
 	}
 
 	/* TODO: Uncomment the following for code generation. */
@@ -176,21 +198,38 @@ int main(int argc, char *argv[])
 		eprintf("JASMIN_JAR environment variable not set");
 	}
 
-	setsrcname(argv[1]);
-
-	/* open the source file, and report an error if it cannot be opened */
-	if ((src_file = fopen(argv[1], "r")) == NULL) {
-		eprintf("File '%s' could not be opened:", argv[1]);
+	/* open the source file, and report an error if it cannot be opened; a
+	 * name of "-" stands for the standard input, which is streamed */
+	if (strcmp(argv[optind], "-") == 0) {
+		setsrcname("stdin");
+		src_file = stdin;
+	} else {
+		setsrcname(argv[optind]);
+		if ((src_file = fopen(argv[optind], "r")) == NULL) {
+			eprintf("File '%s' could not be opened:", argv[optind]);
+		}
 	}
 
 	/* initialise all compiler units */
-	init_scanner(src_file);
+	scanner = init_scanner(src_file);
 	init_symbol_table();
+	if (stats) {
+		set_symbol_table_stats(stderr);
+	}
+
+	/* in pre-scan mode, lexical errors are reported before syntax errors */
+	token_stream = NULL;
+	token_index = 0;
+	if (prescan) {
+		token_stream = ts_init();
+		ts_scan(token_stream, scanner);
+	}
 
 	/* compile */
 	init_code_generation();
-	get_token(&token);
+	next_token();
 	parse_program();
+	print_symbol_table_stats();
 
 	/* produce the object code, and assemble */
 	/* TODO: For code generation. */
@@ -199,7 +238,14 @@ int main(int argc, char *argv[])
 
 	/* release allocated resources */
 	/* TODO: Release resources of symbol table and code generation here */
-	fclose(src_file);
+	if (token_stream != NULL) {
+		ts_free(token_stream);
+	}
+	release_scanner(scanner);
+	release_intern_pool();
+	if (src_file != stdin) {
+		fclose(src_file);
+	}
 	freeprogname();
 	freesrcname();
 
@@ -218,6 +264,7 @@ int main(int argc, char *argv[])
 void parse_program(void)
 {
 	DBG_start("<program>");
+	char *main_id;
 	IDprop *idp_filler = idprop(TYPE_CALLABLE, 0, 0, NULL);
 
 	expect(TOK_PROGRAM);
@@ -234,8 +281,9 @@ void parse_program(void)
 	max_stack_depth = 0;
 
 	expect(TOK_MAIN);
-	insert_name("main", idp_filler);
-	init_subroutine_codegen("main", idp_filler);
+	main_id = intern_string("main", 4);
+	open_subroutine(main_id, idp_filler);
+	init_subroutine_codegen(main_id, idp_filler);
 	expect(TOK_COLON);
 	reset_offset();
 
@@ -244,6 +292,7 @@ void parse_program(void)
 	set_max_stack_depth(max_stack_depth);
 	int variable_width = return_curr_offset();
 	close_subroutine_codegen(variable_width + 1);
+	close_subroutine();
 
 	DBG_end("</program>");
 }
@@ -321,6 +370,7 @@ void parse_funcdef(void)
 		printf("Error here. Could not open sub-routine");
 		exit(1);
 	} else {
+		reserve_names(nparams);
 		var_list = var_list_start;
 		for (var_list = var_list->next; var_list != NULL; var_list = var_list->next) {
 			idp_reusable->type = var_list->type;
@@ -341,7 +391,8 @@ void parse_body(void)
 {
 	DBG_start("<body>");
 
-	Variable *vars;
+	Variable *vars, *v;
+	unsigned int nvars;
 	vars = NULL;
 
 	if (token.type == TOK_VARS) {
@@ -356,6 +407,12 @@ void parse_body(void)
 			parse_varseq(&vars);
 		}
 
+		nvars = 0;
+		for (v = vars; v != NULL; v = v->next) {
+			nvars++;
+		}
+		reserve_names(nvars);
+
 		for (; vars != NULL; vars = vars->next) {
 			idp = idprop(vars->type, 0, 0, NULL);
 			insert_name(vars->id, idp);
@@ -412,7 +469,7 @@ void parse_varseq(Variable **vars)
 		if (temp_var->id == NULL) {
 			break;
 		}
-		if (!strcmp(temp_var->id, key) || find_name(key, &idp)) {
+		if (temp_var->id == key || find_name(key, &idp)) {
 			position = start_pos;
 			abort_compile(ERR_MULTIPLE_DEFINITION, key);
 		}
@@ -436,7 +493,7 @@ void parse_varseq(Variable **vars)
 			if (temp_var->id == NULL) {
 				break;
 			}
-			if (!strcmp(temp_var->id, key) || find_name(key, &idp)) {
+			if (temp_var->id == key || find_name(key, &idp)) {
 				position = start_pos;
 				abort_compile(ERR_MULTIPLE_DEFINITION, key);
 			}
@@ -475,7 +532,7 @@ void parse_type(ValType *type)
 	printf("token.type = %d\n", token.type);
 		abort_compile(ERR_UNREACHABLE);
 	}
-	get_token(&token);
+	next_token();
 
 	if (token.type == TOK_ARRAY) {
 		expect(TOK_ARRAY);
@@ -866,9 +923,9 @@ void parse_output(void)
 	expect(TOK_OUTPUT);
 
 	if (token.type == TOK_STR) {
-		char *string = token.string;
+		StrSlice string = token.string;
 		expect(TOK_STR);
-		gen_print_string(string);
+		gen_print_string(&string);
 	} else if (STARTS_EXPR(token.type)) {
 		parse_expr(&type);
 		if (type & TYPE_CALLABLE) {
@@ -948,7 +1005,7 @@ void parse_expr(ValType *type)
 		
 			start_pos = position;
 			start_pos.col = position.col - strlen(token.lexeme);
-			get_token(&token);
+			next_token();
 			parse_simple(&type2);
 			if (type2 != type1) {
 				check_types(type2, type1, &start_pos, "");
@@ -972,7 +1029,7 @@ void parse_expr(ValType *type)
 					check_types(type1, TYPE_INTEGER, &position, "");
 				}
 			}
-			get_token(&token);
+			next_token();
 			start_pos = position;
 			start_pos.col = position.col - strlen(token.lexeme) - 1;
 			parse_simple(&type2);
@@ -1054,7 +1111,7 @@ void parse_simple(ValType *type)
 			TokenType temp_tok = token.type;
 			start_pos = position;
 			start_pos.col = position.col - strlen(token.lexeme) + 1;
-			get_token(&token);
+			next_token();
 			parse_term(&type2);
 			if (IS_ARRAY(type2)) {
 				position = start_pos;
@@ -1080,7 +1137,7 @@ void parse_simple(ValType *type)
 			}
 			start_pos = position;
 			start_pos.col = position.col - strlen(token.lexeme) + 1;
-			get_token(&token);
+			next_token();
 			parse_term(&type2);
 			if (type2 != TYPE_BOOLEAN) {
 				check_types(type2, TYPE_BOOLEAN, &start_pos, "");
@@ -1126,7 +1183,7 @@ void parse_term(ValType *type)
 			TokenType temp_tok = token.type;
 			start_pos = position;
 			start_pos.col = position.col - strlen(token.lexeme) + 1;
-			get_token(&token);
+			next_token();
 			if (type1 != TYPE_INTEGER) {
 				check_types(type1, TYPE_INTEGER, &start_pos, "");
 			}
@@ -1158,7 +1215,7 @@ void parse_term(ValType *type)
 			}
 			start_pos = position;
 			start_pos.col = position.col - strlen(token.lexeme) + 1;
-			get_token(&token);
+			next_token();
 			parse_factor(&type2);
 			if (type2 != TYPE_BOOLEAN) {
 				check_types(type2, TYPE_BOOLEAN, &start_pos, "");
@@ -1266,7 +1323,7 @@ void parse_factor(ValType *type)
 						if (current_param == nparams) {
 							abort_compile(ERR_TOO_MANY_ARGUMENTS, key);
 						}
-						get_token(&token);
+						next_token();
 						start_pos = position;
 						start_pos.col = position.col - strlen(token.lexeme);
 						parse_expr(&type_local);
@@ -1389,7 +1446,7 @@ void check_types(ValType found, ValType expected, SourcePos *pos, ...)
 void expect(TokenType type)
 {
 	if (token.type == type) {
-		get_token(&token);
+		next_token();
 	} else {
 		abort_compile(ERR_EXPECT, type);
 	}
@@ -1398,13 +1455,22 @@ void expect(TokenType type)
 void expect_id(char **id)
 {
 	if (token.type == TOK_ID) {
-		*id = strdup(token.lexeme);
-		get_token(&token);
+		*id = token.id;
+		next_token();
 	} else {
 		abort_compile(ERR_EXPECT, TOK_ID);
 	}
 }
 
+void next_token(void)
+{
+	if (token_stream != NULL) {
+		ts_get_token(token_stream, token_index++, &token);
+	} else {
+		get_token(scanner, &token);
+	}
+}
+
 void inc_stack_depth(void) {
 	stack_depth++;
 	if (stack_depth > max_stack_depth) {
@@ -1619,7 +1685,7 @@ void debug_end(const char *fmt, ...)
 
 void debug_info(const char *fmt, ...)
 {
-	int i;
+	int i, line, col;
 	char *buf_ptr;
 	va_list ap;
 
@@ -1633,7 +1699,8 @@ void debug_info(const char *fmt, ...)
 	vsprintf(buf_ptr, fmt, ap);
 
 	buf_ptr += strlen(buf_ptr);
-	snprintf(buf_ptr, MAX_MESSAGE_LENGTH, " in line %d.\n", position.line);
+	resolvepos(&position, &line, &col);
+	snprintf(buf_ptr, MAX_MESSAGE_LENGTH, " in line %d.\n", line);
 	fflush(stdout);
 	fputs(msgbuf, stdout);
 	fflush(NULL);
@@ -0,0 +1,368 @@
+/**
+ * @file    benchhash.c
+ * @brief   A benchmark of the hash functions offered to the hash table, over
+ *          generated identifier sets.
+ *
+ * For every identifier set and hash function, the benchmark reports the number
+ * of full-width hash collisions, the distribution of chain lengths when the
+ * hash is reduced modulo a prime table size, as the hash callback of
+ * <code>ht_init</code> does, and the cost of successful and unsuccessful
+ * <code>ht_search</code> calls on a table of the identifiers.  The plain
+ * character sum formerly used by the hash table driver is included for
+ * comparison, as is a table that stores the keys inline, with
+ * <code>ht_init_fixed</code>.
+ *
+ * Build with optimisation for meaningful numbers, for example
+ * <code>make OPTIMISE=-O2 benchhash</code>.
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "error.h"
+#include "hashtable.h"
+
+#define DEFAULT_COUNT 1000
+#define DEFAULT_REPS  1000
+#define KEY_STRIDE    (HT_FIXED_KEY_SIZE + 1)
+#define LOADFACTOR    0.75
+#define MAX_PROBE     4
+
+/** an identifier set, with the function that generates its i-th name */
+typedef struct {
+	const char *name;
+	void (*make)(unsigned int i, char *buf);
+} IdSet;
+
+/** a hash function under test */
+typedef struct {
+	const char *name;
+	unsigned int (*hash)(void *key, unsigned int size);
+	Boolean inline_keys;  /*<< whether the table stores fixed-width keys */
+} HashFn;
+
+/* --- function prototypes -------------------------------------------------- */
+
+static void seq_name(unsigned int i, char *buf);
+static void prefix_name(unsigned int i, char *buf);
+static void alpha_name(unsigned int i, char *buf);
+static void camel_name(unsigned int i, char *buf);
+static unsigned int sum_hash(void *key, unsigned int size);
+static int scmp(void *v1, void *v2);
+static void nofree(void *p);
+static char *make_keys(const IdSet *set, unsigned int from, unsigned int n);
+static void run(const IdSet *set, const HashFn *fn, char *keys, char *hits,
+		char *misses, unsigned int n, unsigned long reps);
+static unsigned int collisions(const HashFn *fn, char *keys, unsigned int n);
+static double time_lookups(HashTab *ht, char *probes, unsigned int n,
+		unsigned long reps, Boolean expect);
+static unsigned int next_prime(unsigned int n);
+static int cmp_uint(const void *a, const void *b);
+static double elapsed(struct timespec *start);
+
+/* --- global static variables ---------------------------------------------- */
+
+static const IdSet sets[] = {
+	{ "seq",    seq_name    },
+	{ "prefix", prefix_name },
+	{ "alpha",  alpha_name  },
+	{ "camel",  camel_name  }
+};
+
+static const HashFn fns[] = {
+	{ "sum",    sum_hash,      FALSE },
+	{ "fnv1a",  ht_hash_fnv1a, FALSE },
+	{ "wy",     ht_hash_wy,    FALSE },
+	{ "fixed",  ht_hash_fixed, FALSE },
+	{ "inline", ht_hash_fixed, TRUE  }
+};
+
+#define NUM_SETS (sizeof(sets) / sizeof(IdSet))
+#define NUM_FNS  (sizeof(fns) / sizeof(HashFn))
+
+/** words from which camel-case names are built */
+static const char *words[] = {
+	"count", "index", "value", "total", "left", "right", "limit", "result",
+	"sum", "flag", "node", "next", "prev", "size", "temp", "acc"
+};
+
+#define NUM_WORDS (sizeof(words) / sizeof(char *))
+
+/* --- main routine --------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	unsigned int i, j, n;
+	unsigned long reps;
+	const char *set_name = NULL, *fn_name = NULL;
+	char *keys, *hits, *misses;
+
+	setprogname(argv[0]);
+	n = DEFAULT_COUNT;
+	reps = DEFAULT_REPS;
+
+	while ((opt = getopt(argc, argv, "n:r:s:h:")) != -1) {
+		switch (opt) {
+			case 'n':
+				n = strtoul(optarg, NULL, 10);
+				break;
+			case 'r':
+				reps = strtoul(optarg, NULL, 10);
+				break;
+			case 's':
+				set_name = optarg;
+				break;
+			case 'h':
+				fn_name = optarg;
+				break;
+			default:
+				eprintf("Usage: %s [-n identifiers] [-r repetitions] "
+						"[-s seq|prefix|alpha|camel] "
+						"[-h sum|fnv1a|wy|fixed|inline]",
+						getprogname());
+		}
+	}
+	if (n == 0) {
+		eprintf("need at least one identifier");
+	}
+
+	printf("%u identifiers, %lu lookups of each, %u buckets for chains\n",
+			n, reps, next_prime(n / LOADFACTOR));
+	printf("%-7s %-6s %6s %5s %6s %7s %7s %7s %7s %9s %9s\n", "set", "hash",
+			"colls", "max", "mean", "p=1", "p=2", "p=3", "p>3", "hit ns",
+			"miss ns");
+
+	for (i = 0; i < NUM_SETS; i++) {
+		if (set_name && strcmp(set_name, sets[i].name) != 0) {
+			continue;
+		}
+		keys = make_keys(&sets[i], 0, n);
+		hits = make_keys(&sets[i], 0, n);
+		misses = make_keys(&sets[i], n, n);
+		for (j = 0; j < NUM_FNS; j++) {
+			if (!fn_name || strcmp(fn_name, fns[j].name) == 0) {
+				run(&sets[i], &fns[j], keys, hits, misses, n, reps);
+			}
+		}
+		free(keys);
+		free(hits);
+		free(misses);
+	}
+
+	freeprogname();
+
+	return EXIT_SUCCESS;
+}
+
+/* --- identifier sets ------------------------------------------------------ */
+
+/** generated temporaries: tmp_000, tmp_001, ... */
+static void seq_name(unsigned int i, char *buf)
+{
+	sprintf(buf, "tmp_%03u", i);
+}
+
+/** long names that differ only in their last few characters */
+static void prefix_name(unsigned int i, char *buf)
+{
+	sprintf(buf, "generated_identifier_%u", i);
+}
+
+/** short names: a, b, ..., z, ba, bb, ... */
+static void alpha_name(unsigned int i, char *buf)
+{
+	char tmp[HT_FIXED_KEY_SIZE];
+	int k = 0;
+
+	do {
+		tmp[k++] = 'a' + i % 26;
+		i /= 26;
+	} while (i > 0);
+	while (k > 0) {
+		*buf++ = tmp[--k];
+	}
+	*buf = '\0';
+}
+
+/** hand-written looking names: countLeft, indexValue, ..., countLeft2 */
+static void camel_name(unsigned int i, char *buf)
+{
+	unsigned int round = i / (NUM_WORDS * NUM_WORDS);
+	const char *second = words[i / NUM_WORDS % NUM_WORDS];
+
+	buf += sprintf(buf, "%s%c%s", words[i % NUM_WORDS], toupper(*second),
+			second + 1);
+	if (round > 0) {
+		sprintf(buf, "%u", round);
+	}
+}
+
+/* --- benchmark ------------------------------------------------------------ */
+
+/**
+ * Generates the names from..from+n-1 of the specified set, each zero-padded
+ * to HT_FIXED_KEY_SIZE bytes, so that every hash function may be applied.
+ */
+static char *make_keys(const IdSet *set, unsigned int from, unsigned int n)
+{
+	unsigned int i;
+	char *keys;
+
+	keys = emalloc((size_t) n * KEY_STRIDE);
+	memset(keys, 0, (size_t) n * KEY_STRIDE);
+	for (i = 0; i < n; i++) {
+		set->make(from + i, keys + i * KEY_STRIDE);
+	}
+
+	return keys;
+}
+
+static void run(const IdSet *set, const HashFn *fn, char *keys, char *hits,
+		char *misses, unsigned int n, unsigned long reps)
+{
+	unsigned int i, size, max, *chains, *c, hist[MAX_PROBE];
+	unsigned long probes;
+	double t_hit, t_miss;
+	HashTab *ht;
+
+	/* chain lengths in a chained table of prime size, and the number of keys
+	 * found at each position along the chains */
+	size = next_prime(n / LOADFACTOR);
+	chains = emalloc(size * sizeof(unsigned int));
+	memset(chains, 0, size * sizeof(unsigned int));
+	memset(hist, 0, sizeof(hist));
+	for (probes = max = i = 0; i < n; i++) {
+		c = &chains[fn->hash(keys + i * KEY_STRIDE, size)];
+		hist[*c < MAX_PROBE ? *c : MAX_PROBE - 1]++;
+		probes += ++*c;
+		if (*c > max) {
+			max = *c;
+		}
+	}
+	free(chains);
+
+	ht = fn->inline_keys ? ht_init_fixed(LOADFACTOR)
+		: ht_init(LOADFACTOR, fn->hash, scmp);
+	if (!ht) {
+		eprintf("Hash table could not be initialised");
+	}
+	for (i = 0; i < n; i++) {
+		if (ht_insert(ht, keys + i * KEY_STRIDE, NULL) != EXIT_SUCCESS) {
+			eprintf("could not insert '%s'", keys + i * KEY_STRIDE);
+		}
+	}
+	t_hit = time_lookups(ht, hits, n, reps, TRUE);
+	t_miss = time_lookups(ht, misses, n, reps, FALSE);
+	ht_free(ht, nofree, nofree);
+
+	printf("%-7s %-6s %6u %5u %6.2f %6.1f%% %6.1f%% %6.1f%% %6.1f%% %9.2f "
+			"%9.2f\n", set->name, fn->name, collisions(fn, keys, n), max,
+			(double) probes / n, 100.0 * hist[0] / n, 100.0 * hist[1] / n,
+			100.0 * hist[2] / n, 100.0 * hist[3] / n,
+			t_hit * 1e9 / ((double) n * reps),
+			t_miss * 1e9 / ((double) n * reps));
+}
+
+/**
+ * Counts the keys whose full-width hash equals that of another key.
+ */
+static unsigned int collisions(const HashFn *fn, char *keys, unsigned int n)
+{
+	unsigned int i, count, *h;
+
+	h = emalloc(n * sizeof(unsigned int));
+	for (i = 0; i < n; i++) {
+		h[i] = fn->hash(keys + i * KEY_STRIDE, UINT_MAX);
+	}
+	qsort(h, n, sizeof(unsigned int), cmp_uint);
+	for (count = 0, i = 1; i < n; i++) {
+		if (h[i] == h[i - 1]) {
+			count++;
+		}
+	}
+	free(h);
+
+	return count;
+}
+
+static double time_lookups(HashTab *ht, char *probes, unsigned int n,
+		unsigned long reps, Boolean expect)
+{
+	struct timespec start;
+	unsigned long r;
+	unsigned int i;
+	void *value;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < reps; r++) {
+		for (i = 0; i < n; i++) {
+			if (ht_search(ht, probes + i * KEY_STRIDE, &value) != expect) {
+				eprintf("wrong result for '%s'", probes + i * KEY_STRIDE);
+			}
+		}
+	}
+
+	return elapsed(&start);
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+/**
+ * The character sum formerly used by the hash table test driver.
+ */
+static unsigned int sum_hash(void *key, unsigned int size)
+{
+	const unsigned char *p = key;
+	unsigned int hash = 0;
+
+	while (*p) {
+		hash += *p++;
+	}
+
+	return hash % size;
+}
+
+static int scmp(void *v1, void *v2)
+{
+	return strcmp((char *) v1, (char *) v2);
+}
+
+static void nofree(void *p)
+{
+	(void) p;
+}
+
+static unsigned int next_prime(unsigned int n)
+{
+	unsigned int d;
+
+	for (n = (n < 2) ? 2 : n; ; n++) {
+		d = 2;
+		while (d * d <= n && n % d != 0) {
+			d++;
+		}
+		if (d * d > n) {
+			return n;
+		}
+	}
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+	return (x > y) - (x < y);
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
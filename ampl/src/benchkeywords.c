@@ -0,0 +1,142 @@
+/**
+ * @file    benchkeywords.c
+ * @brief   A microbenchmark that compares reserved word recognition by perfect
+ *          hashing against the binary search it replaced.
+ *
+ * Build with optimisation for meaningful numbers, for example
+ * <code>make OPTIMISE=-O2 benchkeywords</code>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "error.h"
+#include "scanner.h"
+#include "token.h"
+
+/* --- type definitions and constants --------------------------------------- */
+
+typedef struct {
+	char      *word;
+	TokenType  type;
+} ResWord;
+
+/** the sorted reserved word table used by the former binary search */
+static ResWord sorted[] = {
+	{ "and",     TOK_AND     }, { "array",   TOK_ARRAY   },
+	{ "as",      TOK_AS      }, { "back",    TOK_BACK    },
+	{ "boolean", TOK_BOOLEAN }, { "chillax", TOK_CHILLAX },
+	{ "do",      TOK_DO      }, { "elif",    TOK_ELIF    },
+	{ "else",    TOK_ELSE    }, { "end",     TOK_END     },
+	{ "false",   TOK_FALSE   }, { "if",      TOK_IF      },
+	{ "input",   TOK_INPUT   }, { "integer", TOK_INTEGER },
+	{ "let",     TOK_LET     }, { "main",    TOK_MAIN    },
+	{ "mod",     TOK_MOD     }, { "not",     TOK_NOT     },
+	{ "or",      TOK_OR      }, { "output",  TOK_OUTPUT  },
+	{ "program", TOK_PROGRAM }, { "returns", TOK_RETURNS },
+	{ "takes",   TOK_TAKES   }, { "true",    TOK_TRUE    },
+	{ "vars",    TOK_VARS    }, { "while",   TOK_WHILE   }
+};
+
+/** a word mix resembling AMPL source: mostly identifiers, some keywords */
+static char *words[] = {
+	"i", "count", "tmp_001", "let", "x", "total", "result", "end", "n",
+	"value", "index", "while", "arr", "sum", "flag", "if", "output", "acc",
+	"k", "left", "right", "do", "andx", "mainly", "integer", "tmp_999",
+	"buffer", "vars", "j", "limit", "ORDER", "boolean"
+};
+
+#define NUM_SORTED  (sizeof(sorted) / sizeof(ResWord))
+#define NUM_WORDS   (sizeof(words) / sizeof(char *))
+#define DEFAULT_REPS 2000000
+
+/* --- function prototypes -------------------------------------------------- */
+
+static TokenType binary_search(const char *word);
+static double elapsed(struct timespec *start);
+
+/* --- main routine --------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	struct timespec start;
+	size_t lens[NUM_WORDS];
+	unsigned long i, j, reps, sum_bs, sum_ph;
+	double t_bs, t_ph, n;
+
+	setprogname(argv[0]);
+	reps = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_REPS;
+
+	/* both lookups must agree before we bother timing them */
+	for (j = 0; j < NUM_WORDS; j++) {
+		lens[j] = strlen(words[j]);
+		if (binary_search(words[j]) != lookup_reserved(words[j], lens[j])) {
+			eprintf("lookups disagree on '%s'", words[j]);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (sum_bs = 0, i = 0; i < reps; i++) {
+		for (j = 0; j < NUM_WORDS; j++) {
+			sum_bs += binary_search(words[j]);
+		}
+	}
+	t_bs = elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (sum_ph = 0, i = 0; i < reps; i++) {
+		for (j = 0; j < NUM_WORDS; j++) {
+			sum_ph += lookup_reserved(words[j], lens[j]);
+		}
+	}
+	t_ph = elapsed(&start);
+
+	n = (double) reps * NUM_WORDS;
+	printf("%lu lookups (%lu words, %lu reserved words)\n",
+			(unsigned long) n, (unsigned long) NUM_WORDS,
+			(unsigned long) NUM_SORTED);
+	printf("binary search: %8.2f ns/lookup  (checksum %lu)\n",
+			t_bs * 1e9 / n, sum_bs);
+	printf("perfect hash:  %8.2f ns/lookup  (checksum %lu)\n",
+			t_ph * 1e9 / n, sum_ph);
+	printf("speed-up:      %8.2fx\n", t_bs / t_ph);
+
+	freeprogname();
+
+	return EXIT_SUCCESS;
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+/**
+ * The reserved word binary search formerly used by process_word.
+ */
+static TokenType binary_search(const char *word)
+{
+	int cmp, low, mid, high;
+
+	low = 0;
+	high = NUM_SORTED - 1;
+	while (low <= high) {
+		mid = (low + high) / 2;
+		cmp = strcmp(word, sorted[mid].word);
+		if (cmp < 0) {
+			high = mid - 1;
+		} else if (cmp > 0) {
+			low = mid + 1;
+		} else {
+			return sorted[mid].type;
+		}
+	}
+
+	return TOK_ID;
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
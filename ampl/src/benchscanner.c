@@ -0,0 +1,314 @@
+/**
+ * @file    benchscanner.c
+ * @brief   A non-interactive scanner throughput benchmark over generated
+ *          source text.
+ *
+ * Corpora of a chosen size are generated for several token mixes, and fed to
+ * the scanner either as a regular file, which it maps into memory, or through
+ * a pipe, which it reads in chunks.  For each run, the benchmark reports
+ * tokens per second, megabytes per second, and heap allocations per token.
+ *
+ * Build with optimisation for meaningful numbers, for example
+ * <code>make OPTIMISE=-O2 benchscanner</code>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "error.h"
+#include "intern.h"
+#include "scanner.h"
+#include "skipkernels.h"
+#include "token.h"
+
+#define DEFAULT_MEGABYTES 8
+#define NUM_NAMES         256
+
+/** a token mix, with the function that generates one line of it */
+typedef struct {
+	const char *name;
+	void (*line)(char *buf);
+} Mix;
+
+/** the ways of handing the source to the scanner */
+typedef enum {
+	INPUT_MAP,
+	INPUT_PIPE
+} Input;
+
+/* --- function prototypes -------------------------------------------------- */
+
+static void ident_line(char *buf);
+static void number_line(char *buf);
+static void string_line(char *buf);
+static void comment_line(char *buf);
+static char *make_corpus(const Mix *mix, size_t size, size_t *len);
+static FILE *open_source(const char *corpus, size_t len, Input input,
+		pid_t *writer);
+static void run(const Mix *mix, const char *corpus, size_t len, Input input,
+		const char *kernel);
+static unsigned int next_random(void);
+static double elapsed(struct timespec *start);
+
+/* --- global static variables ---------------------------------------------- */
+
+static const Mix mixes[] = {
+	{ "ident",   ident_line   },
+	{ "number",  number_line  },
+	{ "string",  string_line  },
+	{ "comment", comment_line }
+};
+
+#define NUM_MIXES (sizeof(mixes) / sizeof(Mix))
+
+static const char *input_names[] = { "map", "pipe" };
+
+static unsigned int  seed = 2020;    /* the state of the number generator  */
+static unsigned long nallocs;        /* the number of heap allocations     */
+
+/* --- allocation counting -------------------------------------------------- */
+
+#ifdef __GLIBC__
+/* Every allocation in the program, including those in the scanner units, goes
+ * through these definitions, which count it and pass it on to glibc. */
+
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t n);
+
+void *malloc(size_t n)
+{
+	nallocs++;
+	return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	nallocs++;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n)
+{
+	nallocs++;
+	return __libc_realloc(p, n);
+}
+#endif /* __GLIBC__ */
+
+/* --- main routine --------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	size_t megabytes, len;
+	unsigned int i, input;
+	const char *mix_name = NULL, *input_name = NULL, *kernel = NULL;
+	char *corpus;
+
+	setprogname(argv[0]);
+	setsrcname("generated source");
+	megabytes = DEFAULT_MEGABYTES;
+
+	while ((opt = getopt(argc, argv, "s:m:i:k:")) != -1) {
+		switch (opt) {
+			case 's':
+				megabytes = strtoul(optarg, NULL, 10);
+				break;
+			case 'm':
+				mix_name = optarg;
+				break;
+			case 'i':
+				input_name = optarg;
+				break;
+			case 'k':
+				kernel = optarg;
+				if (!sk_select(kernel)) {
+					eprintf("kernels '%s' not supported", kernel);
+				}
+				break;
+			default:
+				eprintf("Usage: %s [-s megabytes] [-m ident|number|string|"
+						"comment] [-i map|pipe] [-k avx2|sse2|scalar]",
+						getprogname());
+		}
+	}
+
+#ifndef __GLIBC__
+	printf("allocations are only counted with glibc\n");
+#endif
+
+	for (i = 0; i < NUM_MIXES; i++) {
+		if (mix_name != NULL && strcmp(mix_name, mixes[i].name) != 0) {
+			continue;
+		}
+		corpus = make_corpus(&mixes[i], megabytes * 1000000, &len);
+		for (input = INPUT_MAP; input <= INPUT_PIPE; input++) {
+			if (input_name == NULL
+					|| strcmp(input_name, input_names[input]) == 0) {
+				run(&mixes[i], corpus, len, input, kernel);
+			}
+		}
+		free(corpus);
+	}
+
+	release_intern_pool();
+	freeprogname();
+	freesrcname();
+
+	return EXIT_SUCCESS;
+}
+
+/* --- corpus generation ---------------------------------------------------- */
+
+static void ident_line(char *buf)
+{
+	sprintf(buf, "    let name_%u = alpha_%u + beta * gamma_%u - delta;\n",
+			next_random() % NUM_NAMES, next_random() % NUM_NAMES,
+			next_random() % NUM_NAMES);
+}
+
+static void number_line(char *buf)
+{
+	sprintf(buf, "    let x = %u + %u * %u - %u / 7;\n", next_random() % 1000000,
+			next_random() % 100000, next_random() % 1000,
+			next_random() % 10);
+}
+
+static void string_line(char *buf)
+{
+	sprintf(buf, "    output \"value %u is \\\"%u\\\"\\n\" & \"tab\\tdone\";\n",
+			next_random() % 1000, next_random() % 1000);
+}
+
+static void comment_line(char *buf)
+{
+	sprintf(buf, "{ section %u { nested note %u } "
+			"----------------------------------- }\n"
+			"                        let total = total + %u\n",
+			next_random() % 1000, next_random() % 1000, next_random() % 100);
+}
+
+/**
+ * Generates at least the specified number of bytes of source with the
+ * specified token mix.
+ */
+static char *make_corpus(const Mix *mix, size_t size, size_t *len)
+{
+	char line[256], *corpus;
+	size_t n, cap;
+
+	cap = size + sizeof(line);
+	corpus = emalloc(cap);
+	for (*len = 0; *len < size; *len += n) {
+		mix->line(line);
+		n = strlen(line);
+		memcpy(corpus + *len, line, n);
+	}
+
+	return corpus;
+}
+
+/* --- measurement ---------------------------------------------------------- */
+
+/**
+ * Makes the corpus available to the scanner as a stream.  A regular file is
+ * mapped by the scanner; a pipe, which a child process fills, is read.
+ */
+static FILE *open_source(const char *corpus, size_t len, Input input,
+		pid_t *writer)
+{
+	int fd[2];
+	FILE *src;
+
+	*writer = 0;
+	if (input == INPUT_MAP) {
+		if ((src = tmpfile()) == NULL) {
+			eprintf("Temporary file could not be created:");
+		}
+		fwrite(corpus, 1, len, src);
+		fflush(src);
+		rewind(src);
+		return src;
+	}
+
+	if (pipe(fd) == -1 || (*writer = fork()) == -1) {
+		eprintf("Pipe could not be set up:");
+	}
+	if (*writer == 0) {
+		close(fd[0]);
+		if (write(fd[1], corpus, len) != (ssize_t) len) {
+			_exit(EXIT_FAILURE);
+		}
+		_exit(EXIT_SUCCESS);
+	}
+	close(fd[1]);
+	if ((src = fdopen(fd[0], "r")) == NULL) {
+		eprintf("Pipe could not be opened:");
+	}
+
+	return src;
+}
+
+static void run(const Mix *mix, const char *corpus, size_t len, Input input,
+		const char *kernel)
+{
+	struct timespec start;
+	unsigned long ntokens, allocs;
+	double t;
+	pid_t writer;
+	Token token;
+	Scanner *sc;
+	FILE *src;
+
+	src = open_source(corpus, len, input, &writer);
+
+	nallocs = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	sc = init_scanner(src);
+	if (kernel != NULL) {
+		sk_select(kernel);
+	}
+	ntokens = 0;
+	do {
+		get_token(sc, &token);
+		ntokens++;
+	} while (token.type != TOK_EOF);
+	release_scanner(sc);
+
+	t = elapsed(&start);
+	allocs = nallocs;
+
+	fclose(src);
+	if (writer != 0) {
+		waitpid(writer, NULL, 0);
+	}
+
+	printf("%-8s %-5s %-7s %12.0f tokens/s %9.1f MB/s %7lu allocs "
+			"(%.2e/token)\n", mix->name, input_names[input], sk_name(),
+			ntokens / t, len / t / 1e6, allocs, (double) allocs / ntokens);
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+/**
+ * Returns the next number of a linear congruential generator, so that the
+ * corpora are the same from run to run.
+ */
+static unsigned int next_random(void)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 16) & 0x7fff;
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
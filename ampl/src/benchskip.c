@@ -0,0 +1,159 @@
+/**
+ * @file    benchskip.c
+ * @brief   A benchmark that measures scanner throughput on comment-heavy
+ *          source with each of the whitespace and comment skipping kernels.
+ *
+ * Build with optimisation for meaningful numbers, for example
+ * <code>make OPTIMISE=-O2 benchskip</code>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "error.h"
+#include "intern.h"
+#include "scanner.h"
+#include "skipkernels.h"
+#include "token.h"
+
+#define DEFAULT_MEGABYTES 16
+#define DEFAULT_ROUNDS    5
+
+/** a block of generated source: comment banners and deep indentation */
+static const char *block =
+	"{******************************************************************\n"
+	" * { generated section banner }                                     \n"
+	" *                                                                  \n"
+	" * {{ nested notes }  that run on for a while before they close }   \n"
+	" ******************************************************************}\n"
+	"                                                                    \n"
+	"                        let total = total + value;                  \n"
+	"                        {                   aligned remark        } \n"
+	"                                while count < limit:                \n"
+	"                                        let count = count + 1       \n"
+	"                                end;                                \n";
+
+/** the kernels to measure, in order */
+static const char *kernels[] = { "scalar", "sse2", "avx2" };
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(char *))
+
+/* --- function prototypes -------------------------------------------------- */
+
+static FILE *make_source(size_t megabytes, size_t *size);
+static unsigned long scan(FILE *src, const char *kernel);
+static double elapsed(struct timespec *start);
+
+/* --- main routine --------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	struct timespec start;
+	size_t megabytes, size;
+	unsigned long ntokens, expected;
+	unsigned int i, r;
+	double t, best;
+	FILE *src;
+
+	setprogname(argv[0]);
+	setsrcname("generated source");
+	megabytes = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_MEGABYTES;
+
+	src = make_source(megabytes, &size);
+	printf("%lu bytes of comment-heavy source\n", (unsigned long) size);
+
+	expected = 0;
+	for (i = 0; i < NUM_KERNELS; i++) {
+		if (!sk_select(kernels[i])) {
+			printf("%-7s  not supported\n", kernels[i]);
+			continue;
+		}
+
+		/* report the best of a few rounds */
+		best = 0.0;
+		for (r = 0; r < DEFAULT_ROUNDS; r++) {
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			ntokens = scan(src, kernels[i]);
+			t = elapsed(&start);
+			if (r == 0 || t < best) {
+				best = t;
+			}
+		}
+
+		/* every kernel must see the same tokens */
+		if (expected == 0) {
+			expected = ntokens;
+		} else if (ntokens != expected) {
+			eprintf("%s kernels found %lu tokens instead of %lu", kernels[i],
+					ntokens, expected);
+		}
+
+		printf("%-7s  %9.1f MB/s  (%lu tokens)\n", kernels[i],
+				size / best / 1e6, ntokens);
+	}
+
+	fclose(src);
+	release_intern_pool();
+	freeprogname();
+	freesrcname();
+
+	return EXIT_SUCCESS;
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+/**
+ * Writes at least the specified number of megabytes of source to a temporary
+ * file, which the scanner can map.
+ */
+static FILE *make_source(size_t megabytes, size_t *size)
+{
+	size_t len;
+	FILE *src;
+
+	if ((src = tmpfile()) == NULL) {
+		eprintf("Temporary file could not be created:");
+	}
+
+	len = strlen(block);
+	for (*size = 0; *size < megabytes * 1000000; *size += len) {
+		fputs(block, src);
+	}
+	fflush(src);
+
+	return src;
+}
+
+/**
+ * Scans the whole source with the specified kernels, and returns the number of
+ * tokens.
+ */
+static unsigned long scan(FILE *src, const char *kernel)
+{
+	Token token;
+	Scanner *sc;
+	unsigned long ntokens;
+
+	rewind(src);
+	sc = init_scanner(src);
+	sk_select(kernel);
+
+	ntokens = 0;
+	do {
+		get_token(sc, &token);
+		ntokens++;
+	} while (token.type != TOK_EOF);
+
+	release_scanner(sc);
+
+	return ntokens;
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,232 @@
+/**
+ * @file    benchtyped.c
+ * @brief   A benchmark of a typed table from typedtable.h against the generic
+ *          hash table, on interned identifiers.
+ *
+ * Both tables are keyed as the symbol table keys them: by interned pointer,
+ * hashed with <code>intern_hash</code> and compared by address.  The generic
+ * table calls these through function pointers; the typed table inlines them.
+ * For each table, the benchmark reports the cost of filling an emptied table,
+ * as the symbol table does for every subroutine, and of successful and
+ * unsuccessful searches.
+ *
+ * Build with optimisation for meaningful numbers, for example
+ * <code>make OPTIMISE=-O2 benchtyped</code>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "error.h"
+#include "hashtable.h"
+#include "intern.h"
+#include "typedtable.h"
+
+#define DEFAULT_COUNT 8
+#define DEFAULT_REPS  1000000
+#define NAME_SIZE     32
+
+#define PTR_EQ(a, b) ((a) == (b))
+
+TYPED_TABLE(IdTab, idtab, char *, void *, intern_hash, PTR_EQ)
+
+/* --- function prototypes -------------------------------------------------- */
+
+static char **make_ids(unsigned int from, unsigned int n);
+static void bench_generic(char **ids, char **misses, unsigned int n,
+		unsigned long reps);
+static void bench_typed(char **ids, char **misses, unsigned int n,
+		unsigned long reps);
+static unsigned int id_hash(void *key, unsigned int size);
+static int id_cmp(void *val1, void *val2);
+static void report(const char *name, double t_fill, double t_hit,
+		double t_miss, unsigned int n, unsigned long reps);
+static double elapsed(struct timespec *start);
+
+/* --- main routine --------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	unsigned int n;
+	unsigned long reps;
+	char **ids, **misses;
+
+	setprogname(argv[0]);
+	n = DEFAULT_COUNT;
+	reps = DEFAULT_REPS;
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+		switch (opt) {
+			case 'n':
+				n = strtoul(optarg, NULL, 10);
+				break;
+			case 'r':
+				reps = strtoul(optarg, NULL, 10);
+				break;
+			default:
+				eprintf("Usage: %s [-n identifiers] [-r repetitions]",
+						getprogname());
+		}
+	}
+	if (n == 0 || reps == 0) {
+		eprintf("need at least one identifier and one repetition");
+	}
+
+	ids = make_ids(0, n);
+	misses = make_ids(n, n);
+
+	printf("%u identifiers, %lu repetitions\n", n, reps);
+	printf("%-8s %10s %10s %10s\n", "table", "fill ns", "hit ns", "miss ns");
+	bench_generic(ids, misses, n, reps);
+	bench_typed(ids, misses, n, reps);
+
+	free(ids);
+	free(misses);
+	release_intern_pool();
+	freeprogname();
+
+	return EXIT_SUCCESS;
+}
+
+/* --- benchmark ------------------------------------------------------------ */
+
+static char **make_ids(unsigned int from, unsigned int n)
+{
+	unsigned int i;
+	char **ids, name[NAME_SIZE];
+
+	ids = emalloc(n * sizeof(char *));
+	for (i = 0; i < n; i++) {
+		ids[i] = intern_string(name, sprintf(name, "local_%u", from + i));
+	}
+
+	return ids;
+}
+
+static void bench_generic(char **ids, char **misses, unsigned int n,
+		unsigned long reps)
+{
+	struct timespec start;
+	double t_fill, t_hit, t_miss;
+	unsigned long r;
+	unsigned int i;
+	void *value;
+	HashTab *ht;
+
+	if (!(ht = ht_init(0.75f, id_hash, id_cmp))) {
+		eprintf("Hash table could not be initialised");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < reps; r++) {
+		ht_clear(ht, NULL, NULL);
+		for (i = 0; i < n; i++) {
+			ht_insert(ht, ids[i], ids[i]);
+		}
+	}
+	t_fill = elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < reps; r++) {
+		for (i = 0; i < n; i++) {
+			if (!ht_search(ht, ids[i], &value) || value != ids[i]) {
+				eprintf("'%s' not found", ids[i]);
+			}
+		}
+	}
+	t_hit = elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < reps; r++) {
+		for (i = 0; i < n; i++) {
+			if (ht_search(ht, misses[i], &value)) {
+				eprintf("'%s' found", misses[i]);
+			}
+		}
+	}
+	t_miss = elapsed(&start);
+
+	ht_free(ht, NULL, NULL);
+	report("HashTab", t_fill, t_hit, t_miss, n, reps);
+}
+
+static void bench_typed(char **ids, char **misses, unsigned int n,
+		unsigned long reps)
+{
+	struct timespec start;
+	double t_fill, t_hit, t_miss;
+	unsigned long r;
+	unsigned int i;
+	void *value;
+	IdTab t;
+
+	idtab_init(&t, 0.75f);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < reps; r++) {
+		idtab_clear(&t);
+		for (i = 0; i < n; i++) {
+			if (idtab_insert(&t, ids[i], ids[i]) != EXIT_SUCCESS) {
+				eprintf("could not insert '%s'", ids[i]);
+			}
+		}
+	}
+	t_fill = elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < reps; r++) {
+		for (i = 0; i < n; i++) {
+			if (!idtab_search(&t, ids[i], &value) || value != ids[i]) {
+				eprintf("'%s' not found", ids[i]);
+			}
+		}
+	}
+	t_hit = elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (r = 0; r < reps; r++) {
+		for (i = 0; i < n; i++) {
+			if (idtab_search(&t, misses[i], &value)) {
+				eprintf("'%s' found", misses[i]);
+			}
+		}
+	}
+	t_miss = elapsed(&start);
+
+	idtab_free(&t);
+	report("typed", t_fill, t_hit, t_miss, n, reps);
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+static unsigned int id_hash(void *key, unsigned int size)
+{
+	return intern_hash((char *) key) % size;
+}
+
+static int id_cmp(void *val1, void *val2)
+{
+	return val1 != val2;
+}
+
+/**
+ * Prints the time per insertion and per search of one table.
+ */
+static void report(const char *name, double t_fill, double t_hit,
+		double t_miss, unsigned int n, unsigned long reps)
+{
+	double ops = (double) n * reps;
+
+	printf("%-8s %10.2f %10.2f %10.2f\n", name, t_fill * 1e9 / ops,
+			t_hit * 1e9 / ops, t_miss * 1e9 / ops);
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -15,6 +15,7 @@
 #include "boolean.h"
 #include "codegen.h"
 #include "error.h"
+#include "intern.h"
 #include "valtypes.h"
 
 /* --- type definitions and constants --------------------------------------- */
@@ -47,6 +48,7 @@ typedef struct {
 		Label     label;
 		int       num;
 		char     *string;
+		StrSlice  literal;
 	};
 } Code;
 
@@ -228,7 +230,7 @@ void init_subroutine_codegen(const char *name, IDprop *p)
 	ip = 0;
 	code = emalloc(sizeof(Code) * INITIAL_SIZE);
 	code_size = INITIAL_SIZE;
-	function_name = estrdup(name);
+	function_name = intern_string(name, strlen(name));
 	idprop = p;
 }
 
@@ -484,7 +486,7 @@ void gen_print(ValType type)
 	adjust_stack(&instruction_set[JVM_INVOKEVIRTUAL]);
 }
 
-void gen_print_string(char *string)
+void gen_print_string(const StrSlice *string)
 {
 	ensure_space(6);
 
@@ -497,8 +499,8 @@ void gen_print_string(char *string)
 	code[ip].type = CODE_INSTRUCTION;
 	code[ip++].code = JVM_LDC;
 
-	code[ip].type = CODE_OPERAND | CODE_STRING | CODE_ALLOCATED;
-	code[ip++].string = string;
+	code[ip].type = CODE_OPERAND | CODE_STRING;
+	code[ip++].literal = *string;
 
 	code[ip].type = CODE_INSTRUCTION;
 	code[ip++].code = JVM_INVOKEVIRTUAL;
@@ -708,7 +710,9 @@ static void dump_method(FILE *file, Body *b)
 						fprintf(file, " %s\n", c.string);
 						break;
 					case CODE_STRING:
-						fprintf(file, " \"%s\"\n", c.string);
+						/* AMPL-2020 escape codes are also Jasmin's */
+						fprintf(file, " \"%.*s\"\n", (int) c.literal.len,
+								c.literal.text);
 						break;
 					default:
 						weprintf("Unknown data type for bytecode: %x\n",
@@ -104,12 +104,13 @@ void gen_newarray(JVMatype atype);
 void gen_print(ValType type);
 
 /**
- * Generates the instructions for displaying a string on screen.
+ * Generates the instructions for displaying a string on screen.  The string
+ * is not copied, and must remain valid until the code file has been made.
  *
  * @param[in]   string
- *     the string to display
+ *     the string literal to display
  */
-void gen_print_string(char *string);
+void gen_print_string(const StrSlice *string);
 
 /**
  * Generates the instructions for reading from standard input into a variable.
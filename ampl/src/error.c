@@ -81,12 +81,18 @@
 
 /* --- error routines ------------------------------------------------------- */
 
-SourcePos position;
+_Thread_local SourcePos position;
 
+/* The program name is shared, but the source name and position belong to the
+ * thread that compiles the source. */
 #ifndef __APPLE__
 static char *pname = NULL;
 #endif
-static char *sname = NULL;
+static _Thread_local char *sname = NULL;
+static _Thread_local void (*resolver)(void *, unsigned int, int *, int *) =
+	NULL;
+static _Thread_local void *resolver_context = NULL;
+static _Thread_local jmp_buf *error_trap = NULL;
 
 static void _weprintf(const char *pre, const SourcePos *pos, const char *fmt,
 		va_list args)
@@ -97,14 +103,19 @@ static void _weprintf(const char *pre, const SourcePos *pos, const char *fmt,
 	const char *ac_pos = (istty ? ASCII_BOLD_WHITE : "");
 	const char *progname = getprogname();
 	const char *srcname = getsrcname();
+	int line, col;
 
+	/* keep the lines of messages from different threads apart */
 	fflush(stdout);
+	flockfile(stderr);
 	if (progname != NULL)
 		fprintf(stderr, "%s:", progname);
 	if (srcname != NULL)
 		fprintf(stderr, " %s%s:%s", ac_src, srcname, ac_end);
-	if (pos != NULL)
-		fprintf(stderr, "%s%d:%d%s:", ac_pos, pos->line, pos->col, ac_end);
+	if (pos != NULL) {
+		resolvepos(pos, &line, &col);
+		fprintf(stderr, "%s%d:%d%s:", ac_pos, line, col, ac_end);
+	}
 	if (pre != NULL)
 		fprintf(stderr, " %s ", pre);
 	else
@@ -115,6 +126,7 @@ static void _weprintf(const char *pre, const SourcePos *pos, const char *fmt,
 	if (fmt[0] != '\0' && fmt[strlen(fmt)-1] == ':')
 		fprintf(stderr, " %s", strerror(errno));
 	fprintf(stderr, "\n");
+	funlockfile(stderr);
 }
 
 void eprintf(const char *fmt, ...)
@@ -137,12 +149,20 @@ void leprintf(const char *fmt, ...)
 	const char *pre =
 		(istty ? ASCII_BOLD_RED "error:" ASCII_RESET : "error:");
 
+	if (error_trap != NULL)
+		longjmp(*error_trap, 1);
+
 	va_start(args, fmt);
 	_weprintf(pre, &position, fmt, args);
 	va_end(args);
 	exit(2);
 }
 
+void seterrortrap(jmp_buf *trap)
+{
+	error_trap = trap;
+}
+
 void weprintf(const char *fmt, ...)
 {
 	int istty = isatty(2);
@@ -261,6 +281,30 @@ char *getsrcname(void)
 	return sname;
 }
 
+void setposresolver(void (*resolve)(void *context, unsigned int offset,
+			int *line, int *col), void *context)
+{
+	resolver = resolve;
+	resolver_context = context;
+}
+
+void releaseposresolver(void *context)
+{
+	if (resolver_context == context) {
+		resolver = NULL;
+		resolver_context = NULL;
+	}
+}
+
+void resolvepos(const SourcePos *pos, int *line, int *col)
+{
+	*line = *col = 0;
+	if (resolver != NULL)
+		resolver(resolver_context, pos->offset, line, col);
+	*line += pos->line;
+	*col += pos->col;
+}
+
 void freeprogname(void)
 {
 #ifndef __APPLE__
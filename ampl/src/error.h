@@ -19,13 +19,24 @@
 #ifndef ERROR_H
 #define ERROR_H
 
-/** a place (position) in the source file */
+#include <setjmp.h>
+
+/**
+ * a place (position) in the source file: a byte offset, which is only turned
+ * into a line and column number when the position is reported, together with
+ * adjustments to that line and column number
+ */
 typedef struct {
-	int line;  /**< the line number   */
-	int col;   /**< the column number */
+	unsigned int offset;  /**< the byte offset into the source      */
+	int line;             /**< added to the line number of offset   */
+	int col;              /**< added to the column number of offset */
 } SourcePos;
 
-extern SourcePos position;
+/**
+ * the position at which the calling thread reports errors; every thread has its
+ * own, so that several source files can be compiled at once
+ */
+extern _Thread_local SourcePos position;
 
 /**
  * Displays an error message on the standard error stream and exit.
@@ -48,6 +59,16 @@ void eprintf(const char *fmt, ...);
  */
 void leprintf(const char *fmt, ...);
 
+/**
+ * Makes <code>leprintf</code> jump to the specified buffer on the calling
+ * thread, instead of displaying a message and exiting, for work whose errors
+ * may not be real, such as speculative scanning.
+ *
+ * @param[in]   trap
+ *     the buffer to jump to, or <code>NULL</code> to report errors again
+ */
+void seterrortrap(jmp_buf *trap);
+
 /**
  * Displays an error message on the standard error stream, with a tag prepended,
  * and exit.
@@ -145,7 +166,7 @@ void *werealloc(void *vp, size_t n);
 void freeprogname(void);
 
 /**
- * Frees the source name.
+ * Frees the source name of the calling thread.
  */
 void freesrcname(void);
 
@@ -159,7 +180,7 @@ char *getprogname(void);
 #endif
 
 /**
- * Returns the stored source name.
+ * Returns the stored source name of the calling thread.
  *
  * @return      the stored source name
  */
@@ -176,11 +197,46 @@ void setprogname(char *s);
 #endif
 
 /**
- * Sets the source name.
+ * Sets the source name of the calling thread.
  *
  * @param[in]   s
  *     the source name
  */
 void setsrcname(char *s);
 
+/**
+ * Sets the function that finds the line and column number of a source offset
+ * for the calling thread.  Without one, offsets are taken to be on line 0,
+ * column 0.
+ *
+ * @param[in]   resolve
+ *     the function that stores the line and column number of the offset, or
+ *     <code>NULL</code>
+ * @param[in]   context
+ *     passed to the function, to identify the source
+ */
+void setposresolver(void (*resolve)(void *context, unsigned int offset,
+			int *line, int *col), void *context);
+
+/**
+ * Removes the position resolver of the calling thread if it was set with the
+ * specified context, typically because the context is about to be freed.
+ *
+ * @param[in]   context
+ *     the context of the resolver to remove
+ */
+void releaseposresolver(void *context);
+
+/**
+ * Finds the line and column number of the specified source position.
+ *
+ * @param[in]   pos
+ *     the source position
+ * @param[out]  line
+ *     the line number
+ * @param[out]  col
+ *     the column number
+ */
+void resolvepos(const SourcePos *pos, int *line, int *col);
+
 #endif /* ERROR_H */
@@ -5,310 +5,1678 @@
  * @date    2020-08-10
  */
 
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "hashtable.h"
 
-#define INITIAL_DELTA_INDEX  4
+#if defined(__SSE2__) && defined(__GNUC__)
+#define HAVE_SSE2_GROUPS
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__) && defined(__GNUC__)
+#define HAVE_AVX2_KEYS
+#include <immintrin.h>
+#endif
+
+/* The table uses open addressing over a flat array of slots.  Each slot has a
+ * control byte that is either CTRL_EMPTY, CTRL_DELETED, or holds the low seven
+ * bits of the hash of the key stored in it.  Slots are probed in groups of
+ * GROUP_WIDTH: the control bytes of a whole group are compared against the tag
+ * of the key in a single SSE2 comparison, and only the slots whose tags match
+ * have their keys compared.  A group that still has an empty slot ends the
+ * probe.
+ * Each slot also keeps the full hash of its key, so that tag matches of
+ * different keys are mostly rejected without calling the comparison function,
+ * and so that entries can be moved without hashing their keys again.
+ * Deleting an entry leaves a tombstone (CTRL_DELETED) only if its group is
+ * full, since only then may probes for other keys have passed through it.
+ *
+ * Growing the table does not move all entries at once.  A new array of twice
+ * the size is allocated, and the old one is kept, read-only, until every
+ * operation on the table has migrated another MIGRATE_SLOTS of its slots.
+ * Until then, lookups that miss in the new array also probe the old one.
+ * Copied entries are left in place in the old array; since a copy is always
+ * found in the new array first, this does no harm.
+ *
+ * A shared table is searched without locks, while inserts are serialised by a
+ * mutex.  A writer fills in a slot before it stores the control byte with
+ * release semantics, and a reader that matches a tag reloads that byte with
+ * acquire semantics before it reads the slot.  Shared tables grow in one
+ * step: the writer copies all entries into a new array, and publishes it with
+ * a single pointer store.  Readers announce the epoch in which they started,
+ * and an old array is freed only once no reader from its epoch or earlier is
+ * still probing it.
+ *
+ * A table of at most SMALL_ENTRIES entries has no slot array at all.  Its
+ * entries are kept in insertion order in the container itself, with their
+ * hashes packed apart so that all of them are compared in two SSE2
+ * comparisons.  The slot array is allocated only when an insert would exceed
+ * SMALL_ENTRIES, or when room is reserved for more.  Shared tables are never
+ * small.
+ *
+ * A frozen table holds its entries in an array of exactly one slot per entry,
+ * placed by a minimal perfect hash in the style of hash-and-displace: the
+ * entries are split into buckets by their hash, and every bucket, largest
+ * first, is given the first seed that sends all of its entries to free slots.
+ * A lookup hashes the key with the seed of its bucket, and compares the key of
+ * the one slot so found.
+ *
+ * A table with fixed-width keys stores a copy of every key, a zero-padded
+ * block of HT_FIXED_KEY_SIZE bytes, in its slot array (or frozen array) next
+ * to the slots, and points the key of the slot at that copy.  Since the keys
+ * passed in are padded alike, two keys are equal exactly when their blocks
+ * are, which one AVX2 or two SSE2 comparisons decide.  Such tables are never
+ * small.
+ */
+
+#define GROUP_WIDTH       16
+#define CTRL_EMPTY        ((signed char) -128)
+#define CTRL_DELETED      ((signed char) -2)
+#define IS_FULL(c)        ((c) >= 0)
+#define INITIAL_CAPACITY  16
+#define MAX_LOADFACTOR    0.875f
+#define MIGRATE_SLOTS     GROUP_WIDTH
 #define PRINT_BUFFER_SIZE 1024
+#define SLAB_SIZE         4096
+#define SLAB_ALIGN        16
+#define SMALL_ENTRIES     8
+#define IS_SMALL(ht)      ((ht)->cur.capacity == 0 && !(ht)->frozen)
+#define FROZEN_BUCKET     2
+#define FROZEN_TRIES      64
+
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME  16777619U
+#define WY_P0      0xa0761d6478bd642fULL
+#define WY_P1      0xe7037ed1a0b428dbULL
+#define WY_P2      0x8ebc6af09c88c6e3ULL
+#define WY_P3      0x589965cc75374cc3ULL
+
+/** a slot in the hash table */
+typedef struct {
+	void         *key;    /*<< the key                   */
+	void         *value;  /*<< the value                 */
+	unsigned int  hash;   /*<< the full, mixed key hash  */
+} Slot;
+
+/** an array of slots with their control bytes */
+typedef struct {
+	signed char   *ctrl;      /*<< the control bytes, one per slot          */
+	Slot          *slots;     /*<< the slots                                */
+	unsigned char *keys;      /*<< the fixed-width keys, if any, one a slot */
+	unsigned int   capacity;  /*<< a power of two and a multiple of a group */
+} SlotArray;
+
+/** a block of memory handed out by ht_alloc */
+typedef struct slab Slab;
+struct slab {
+	Slab   *next;    /*<< the previously filled slab      */
+	size_t  size;    /*<< the number of bytes in data     */
+	size_t  used;    /*<< the number of bytes handed out  */
+	_Alignas(SLAB_ALIGN) unsigned char data[];  /*<< the memory */
+};
+
+/** a reader of shared tables, one per thread that has searched any */
+typedef struct reader Reader;
+struct reader {
+	unsigned long  epoch;   /*<< the epoch at entry, or 0 when not reading */
+	int            in_use;  /*<< whether a live thread owns the record     */
+	Reader        *next;    /*<< the next record in the registry           */
+};
 
-/** an entry in the hash table */
-typedef struct htentry HTentry;
-struct htentry {
-	void    *key;       /*<< the key                      */
-	void    *value;     /*<< the value                    */
-	HTentry *next_ptr;  /*<< the next entry in the bucket */
+/** a slot array of a shared table that readers may still be probing */
+typedef struct retired Retired;
+struct retired {
+	SlotArray     *array;  /*<< the replaced array                      */
+	unsigned long  epoch;  /*<< the last epoch in which it was reachable */
+	Retired       *next;   /*<< the array replaced before this one      */
 };
 
+/** the entries of a frozen table, with their perfect hash */
+typedef struct {
+	unsigned int  size;      /*<< the number of entries and slots */
+	unsigned int  nbuckets;  /*<< the number of buckets           */
+	unsigned int *seeds;     /*<< the seed of every bucket        */
+	Slot          slots[];   /*<< the entries, followed by seeds  */
+} Frozen;
+
 /** a hash table container */
 struct hashtab {
-	/** a pointer to the underlying table                              */
-	HTentry **table;
-	/** the current size of the underlying table                       */
-	unsigned int size;
+	/** the slot array into which entries are inserted                 */
+	SlotArray cur;
+	/** the slot array being migrated, or one without slots            */
+	SlotArray old;
+	/** the number of slots of the old array already migrated          */
+	unsigned int migrated;
 	/** the current number of entries                                  */
 	unsigned int num_entries;
+	/** the number of tombstones in the current slot array             */
+	unsigned int num_deleted;
+	/** the number of entries at which the slot array is grown         */
+	unsigned int max_entries;
 	/** the maximum load factor before the underlying table is resized */
 	float max_loadfactor;
-	/** the index into the delta array                                 */
-	unsigned short idx;
 	/** a pointer to the hash function                                 */
 	unsigned int (*hash)(void *, unsigned int);
 	/** a pointer to the comparison function                           */
 	int (*cmp)(void *, void *);
+	/** the slab from which ht_alloc currently allocates               */
+	Slab *slab;
+	/** the number of times the slot array has been replaced           */
+	unsigned int rehashes;
+	/** the number of successful searches                              */
+	unsigned long hits;
+	/** the number of unsuccessful searches                            */
+	unsigned long misses;
+	/** whether the table may be searched while it is being modified   */
+	Boolean shared;
+	/** the lock that serialises writers to a shared table             */
+	pthread_mutex_t lock;
+	/** the slot array that readers of a shared table probe            */
+	SlotArray *published;
+	/** the replaced slot arrays of a shared table not yet freed       */
+	Retired *retired;
+	/** the hashes of the entries of a small table                     */
+	unsigned int small_hash[SMALL_ENTRIES];
+	/** the entries of a small table, in insertion order               */
+	Slot small[SMALL_ENTRIES];
+	/** the entries of a frozen table, or NULL if it is not frozen     */
+	Frozen *frozen;
+	/** whether the table stores its keys, HT_FIXED_KEY_SIZE bytes wide */
+	Boolean fixed;
 };
 
 /* --- function prototypes -------------------------------------------------- */
 
-static int getsize(HashTab *ht);
-static void rehash(HashTab *ht);
-static void freekey(void *k);
-static void freeval(void *v);
+static int insert(HashTab *ht, void *key, void *value);
+static Boolean search_shared(HashTab *ht, void *key, void **value);
+static Boolean publish(HashTab *ht);
+static Boolean rehash_shared(HashTab *ht, unsigned int capacity);
+static void reclaim(HashTab *ht, Boolean all);
+static void enter_epoch(void);
+static void leave_epoch(void);
+static void make_reader_key(void);
+static void release_reader(void *r);
+static unsigned int full_hash(HashTab *ht, void *key);
+static Slot *lookup(HashTab *ht, void *key, unsigned int hash);
+static Slot *find_slot(HashTab *ht, SlotArray *a, void *key,
+		unsigned int hash);
+static unsigned int free_slot(SlotArray *a, unsigned int hash);
+static void put(HashTab *ht, void *key, void *value, unsigned int hash);
+static Boolean erase(SlotArray *a, Slot *s);
+static void visit(HashTab *ht, void (*freekey)(void *k),
+		void (*freeval)(void *v));
+static Boolean alloc_slots(HashTab *ht, unsigned int capacity);
+static Boolean promote(HashTab *ht, unsigned int capacity);
+static Slot *find_small(HashTab *ht, void *key, unsigned int hash);
+static unsigned int match_small(HashTab *ht, unsigned int hash);
+static int seed_buckets(HashTab *ht, Frozen *f, Slot *entries,
+		unsigned int *first, unsigned char *taken);
+static Boolean place_bucket(Frozen *f, Slot *members, unsigned int n,
+		unsigned char *taken, unsigned int *seed);
+static int cmp_hash(const void *a, const void *b);
+static Boolean keys_equal(HashTab *ht, void *key, void *stored);
+static int cmp_fixed(void *val1, void *val2);
+static Slot *find_frozen(HashTab *ht, void *key, unsigned int hash);
+static unsigned int seeded(unsigned int hash, unsigned int seed);
+static unsigned int reduce(unsigned int hash, unsigned int n);
+static unsigned int capacity_for(HashTab *ht, unsigned int n);
+static Boolean rehash(HashTab *ht);
+static Boolean resize(HashTab *ht, unsigned int capacity);
+static void migrate(HashTab *ht, unsigned int nslots);
+static void free_slots(SlotArray *a);
+static void probe_stats(SlotArray *a, unsigned int from, HTstats *stats,
+		unsigned long *total);
+static unsigned int probe_length(SlotArray *a, unsigned int i);
+static unsigned int match_tag(const signed char *group, signed char tag);
+static unsigned int match_free(const signed char *group);
+static unsigned long long mum(unsigned long long a, unsigned long long b);
+static unsigned long long read8(const unsigned char *p);
+static unsigned long long read4(const unsigned char *p);
 
-/* TODO: For this implementation, we want to ensure we *always* have a hash
- * table that is of prime size.  To that end, the next array stores the
- * difference between a power of two and the largest prime less than that
- * particular power of two.  When you rehash, compute the new prime size using
- * the following array.
- */
-
-/** the array of differences between a power-of-two and the largest prime less
- * than that power-of-two.                                                    */
-unsigned short delta[] = { 0, 0, 1, 1, 3, 1, 3, 1, 5, 3, 3, 9, 3, 1, 3, 19, 15,
-1, 5, 1, 3, 9, 3, 15, 3, 39, 5, 39, 57, 3, 35, 1 };
+/* --- global static variables ---------------------------------------------- */
 
-#define MAX_IDX (sizeof(delta) / sizeof(short))
+static unsigned long global_epoch = 1;  /* the epoch of shared tables     */
+static Reader *readers;                 /* the registry of reader records */
+static pthread_mutex_t readers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t reader_once = PTHREAD_ONCE_INIT;
+static pthread_key_t reader_key;        /* releases records at thread exit */
+static _Thread_local Reader *self;      /* the record of this thread      */
 
 /* --- hash table interface ------------------------------------------------- */
 
 HashTab *ht_init(float loadfactor,
 				 unsigned int (*hash)(void *, unsigned int),
 				 int (*cmp)(void *, void *))
+{
+	return ht_init_with_capacity(0, loadfactor, hash, cmp);
+}
+
+HashTab *ht_init_with_capacity(unsigned int capacity, float loadfactor,
+		unsigned int (*hash)(void *, unsigned int),
+		int (*cmp)(void *, void *))
+{
+	HashTab *ht;
+
+	if (!(ht = malloc(sizeof(HashTab)))) {
+		return NULL;
+	}
+
+	ht->num_entries = 0;
+	ht->max_loadfactor = (loadfactor > 0 && loadfactor < MAX_LOADFACTOR)
+		? loadfactor : MAX_LOADFACTOR;
+	ht->hash = hash;
+	ht->cmp = cmp;
+	ht->old.capacity = ht->migrated = 0;
+	ht->slab = NULL;
+	ht->rehashes = 0;
+	ht->hits = ht->misses = 0;
+	ht->shared = FALSE;
+	ht->published = NULL;
+	ht->retired = NULL;
+	ht->frozen = NULL;
+	ht->fixed = FALSE;
+
+	if (capacity <= SMALL_ENTRIES) {
+		ht->cur.capacity = 0;
+		ht->num_deleted = 0;
+		ht->max_entries = SMALL_ENTRIES;
+	} else if (!alloc_slots(ht, capacity_for(ht, capacity))) {
+		free(ht);
+		return NULL;
+	}
+
+	return ht;
+}
+
+HashTab *ht_init_shared(float loadfactor,
+						unsigned int (*hash)(void *, unsigned int),
+						int (*cmp)(void *, void *))
+{
+	HashTab *ht;
+
+	if (!(ht = ht_init(loadfactor, hash, cmp))) {
+		return NULL;
+	}
+
+	if (!promote(ht, INITIAL_CAPACITY) || !publish(ht)) {
+		ht_free(ht, NULL, NULL);
+		return NULL;
+	}
+	pthread_mutex_init(&ht->lock, NULL);
+	ht->shared = TRUE;
+
+	return ht;
+}
+
+HashTab *ht_init_fixed(float loadfactor)
 {
 	HashTab *ht;
 
-	/* TODO:
-	 * - Initalise a hash table structure by calling an allocation function
-	 *   twice:
-	 *   (1) once to allocate space for a HashTab variable, and
-	 *   (2) once to allocate space for the table field of this new HashTab
-	 *       variable.
-	 * - If any allocation fails, free anything that has already been allocated
-	 *   successfully, and return NULL.
-	 * - Also set up the other fields of the newly-allocated HashTab structure
-	 *   appropriately.
-	 */
-
-	 ht = malloc(sizeof(HashTab));
-
-	 if (!ht) {
+	if (!(ht = ht_init(loadfactor, ht_hash_fixed, cmp_fixed))) {
 		return NULL;
-	 } else {
-		(*ht).num_entries = 0;
-		(*ht).max_loadfactor = loadfactor;
-		(*ht).idx = INITIAL_DELTA_INDEX;
-		(*ht).hash = hash;
-		(*ht).cmp = cmp;
-		(*ht).size = getsize(ht);
-	 }
-
-	(*ht).table = malloc(sizeof(HTentry)*((*ht).size));
-
-	if (!((*ht).table)) {
+	}
+
+	ht->fixed = TRUE;
+	if (!promote(ht, INITIAL_CAPACITY)) {
 		free(ht);
 		return NULL;
 	}
-	
+
 	return ht;
 }
 
 int ht_insert(HashTab *ht, void *key, void *value)
 {
-	int k;
-	HTentry *p;
+	int ret;
+
+	if (ht->shared) {
+		pthread_mutex_lock(&ht->lock);
+		ret = insert(ht, key, value);
+		reclaim(ht, FALSE);
+		pthread_mutex_unlock(&ht->lock);
+		return ret;
+	}
 
-	/* TODO: Insert a new key--value pair, rehashing if necessary.  The best way
-	 * to go about rehashing is to put the necessary elements into a static
-	 * function called rehash.  Remember to free space (the "old" table) you do
-	 * not use any longer.  Also, if something goes wrong, use the #define'd
-	 * constants in hashtable.h for return values; remember, unless it runs out
-	 * of memory, no operation on a hash table may terminate the program.
-	 */
+	return insert(ht, key, value);
+}
 
-	int i = 0;
+Boolean ht_search(HashTab *ht, void *key, void **value)
+{
+	Slot *s;
 
-	if (ht_search(ht, key, &value)) {
-		return HASH_TABLE_KEY_VALUE_PAIR_EXISTS;
+	if (ht->shared && !ht->frozen) {
+		return search_shared(ht, key, value);
 	}
 
-	if ((ht->num_entries + 1.00)/(ht->size) >= ht->max_loadfactor) {
-		rehash(ht);
+	if ((s = lookup(ht, key, full_hash(ht, key)))) {
+		*value = s->value;
 	}
 
-	k = ht->hash(key, ht->size);
+	/* frozen shared tables may be searched by several threads at once */
+	if (ht->shared) {
+		__atomic_fetch_add(s ? &ht->hits : &ht->misses, 1, __ATOMIC_RELAXED);
+	} else if (s) {
+		ht->hits++;
+	} else {
+		ht->misses++;
+	}
+
+	return s ? TRUE : FALSE;
+}
+
+int ht_insert_many(HashTab *ht, void **keys, void **values, unsigned int n)
+{
+	unsigned int i;
+	int ret;
 
-	for (p = ht->table[k]; TRUE; p = p->next_ptr, i++) {
-		if (i == 0 && p == NULL) {
-			p = (HTentry *)malloc(sizeof(HTentry));
-			p->key = malloc(sizeof(void *));
-			p->value = malloc(sizeof(void *));
-			
-			p->key = key;
-			p->value = value;
-			p->next_ptr = NULL;
-			
-			ht->table[k] = (HTentry *)malloc(sizeof(HTentry));
-			ht->table[k] = p;
-			break;
-		} else if (p->next_ptr == NULL) {
-			p->next_ptr = (HTentry *)malloc(sizeof(HTentry));
-			p->next_ptr->key = malloc(sizeof(void *));
-			p->next_ptr->value = malloc(sizeof(void *));
+	/* on failure, the inserts below grow the table one step at a time */
+	ht_reserve(ht, n);
 
-			p->next_ptr->key = key;
-			p->next_ptr->value = value;
-			p->next_ptr->next_ptr = NULL;
-			break;
+	for (i = 0; i < n; i++) {
+		if ((ret = ht_insert(ht, keys[i], values[i])) != EXIT_SUCCESS) {
+			return ret;
 		}
 	}
 
-	(ht->num_entries)++;
 	return EXIT_SUCCESS;
 }
 
-Boolean ht_search(HashTab *ht, void *key, void **value)
+int ht_reserve(HashTab *ht, unsigned int n)
+{
+	unsigned int capacity;
+	Boolean ok;
+
+	if (ht->frozen) {
+		return HASH_TABLE_FROZEN;
+	}
+	if (ht->shared) {
+		pthread_mutex_lock(&ht->lock);
+	}
+
+	capacity = capacity_for(ht, (ht->num_entries > UINT_MAX - n)
+			? UINT_MAX : ht->num_entries + n);
+	if (IS_SMALL(ht)) {
+		ok = ht->num_entries + n <= SMALL_ENTRIES || promote(ht, capacity);
+	} else {
+		ok = capacity <= ht->cur.capacity || (ht->shared
+				? rehash_shared(ht, capacity) : resize(ht, capacity));
+	}
+
+	if (ht->shared) {
+		pthread_mutex_unlock(&ht->lock);
+	}
+
+	return ok ? EXIT_SUCCESS : HASH_TABLE_NO_SPACE_FOR_NODE;
+}
+
+/* --- shared tables -------------------------------------------------------- */
+
+static int insert(HashTab *ht, void *key, void *value)
 {
-	int k;
-	HTentry *p;
+	unsigned int hash;
+
+	if (ht->frozen) {
+		return HASH_TABLE_FROZEN;
+	}
 
-	/* TODO: Nothing!  This function is complete, and it should explain by
-	 * example how the hash table looks and must be accessed.
-	 */
+	hash = full_hash(ht, key);
+	if (lookup(ht, key, hash)) {
+		return HASH_TABLE_KEY_VALUE_PAIR_EXISTS;
+	}
 
-	k = ht->hash(key, ht->size);
-	for (p = ht->table[k]; p; p = p->next_ptr) {
-		if (ht->cmp(key, p->key) == 0) {
-			*value = p->value;
-			break;
+	if (IS_SMALL(ht)) {
+		if (ht->num_entries < SMALL_ENTRIES) {
+			ht->small_hash[ht->num_entries] = hash;
+			ht->small[ht->num_entries].key = key;
+			ht->small[ht->num_entries].value = value;
+			ht->small[ht->num_entries].hash = hash;
+			ht->num_entries++;
+			return EXIT_SUCCESS;
+		}
+		if (!promote(ht, capacity_for(ht, SMALL_ENTRIES + 1))) {
+			return HASH_TABLE_NO_SPACE_FOR_NODE;
 		}
 	}
 
-	return (p ? TRUE : FALSE);
+	if (ht->num_entries + ht->num_deleted >= ht->max_entries
+			&& !rehash(ht)) {
+		return HASH_TABLE_NO_SPACE_FOR_NODE;
+	}
+
+	put(ht, key, value, hash);
+	ht->num_entries++;
+
+	return EXIT_SUCCESS;
+}
+
+static Boolean search_shared(HashTab *ht, void *key, void **value)
+{
+	unsigned int hash;
+	Slot *s;
+
+	hash = full_hash(ht, key);
+	enter_epoch();
+	if ((s = find_slot(ht, __atomic_load_n(&ht->published, __ATOMIC_SEQ_CST),
+					key, hash))) {
+		*value = s->value;
+	}
+	leave_epoch();
+
+	__atomic_fetch_add(s ? &ht->hits : &ht->misses, 1, __ATOMIC_RELAXED);
+	return s ? TRUE : FALSE;
 }
 
-Boolean ht_free(HashTab *ht, void (*freekey)(void *k), void (*freeval)(void *v))
+/**
+ * Makes the current slot array the one that readers probe.
+ */
+static Boolean publish(HashTab *ht)
+{
+	if (!(ht->published = malloc(sizeof(SlotArray)))) {
+		return FALSE;
+	}
+	*ht->published = ht->cur;
+
+	return TRUE;
+}
+
+/**
+ * Moves all entries of a shared table to a new slot array of the specified
+ * capacity, publishes it and retires the array that readers probed before.
+ */
+static Boolean rehash_shared(HashTab *ht, unsigned int capacity)
 {
+	SlotArray a = ht->cur, *p;
+	Retired *r = NULL;
 	unsigned int i;
-	HTentry *p;
-
-	/* free the nodes in the buckets */
-	/* TODO */
-	for (i = 0; i < ht->size; i++) {
-		if (ht->table[i] != NULL) {
-			for (p = ht->table[i]; p != NULL; p = p->next_ptr) {
-				freekey(p->key);
-				freeval(p->value);
-				free(p);
+
+	if (!(p = malloc(sizeof(SlotArray))) || !(r = malloc(sizeof(Retired)))
+			|| !alloc_slots(ht, capacity)) {
+		free(p);
+		free(r);
+		return FALSE;
+	}
+
+	for (i = 0; i < a.capacity; i++) {
+		if (IS_FULL(a.ctrl[i])) {
+			put(ht, a.slots[i].key, a.slots[i].value, a.slots[i].hash);
+		}
+	}
+	*p = ht->cur;
+
+	r->array = ht->published;
+	r->next = ht->retired;
+	ht->retired = r;
+	__atomic_store_n(&ht->published, p, __ATOMIC_SEQ_CST);
+
+	/* readers that enter from now on cannot reach the retired array */
+	r->epoch = __atomic_fetch_add(&global_epoch, 1, __ATOMIC_SEQ_CST);
+	ht->rehashes++;
+
+	return TRUE;
+}
+
+/**
+ * Frees the retired slot arrays that no reader can still be probing, or all of
+ * them.
+ */
+static void reclaim(HashTab *ht, Boolean all)
+{
+	unsigned long oldest = ULONG_MAX, e;
+	Retired **rp, *r;
+	Reader *p;
+
+	if (!all) {
+		for (p = __atomic_load_n(&readers, __ATOMIC_ACQUIRE); p; p = p->next) {
+			e = __atomic_load_n(&p->epoch, __ATOMIC_SEQ_CST);
+			if (e != 0 && e < oldest) {
+				oldest = e;
+			}
+		}
+	}
+
+	for (rp = &ht->retired; (r = *rp); ) {
+		if (all || r->epoch < oldest) {
+			*rp = r->next;
+			free(r->array->slots);
+			free(r->array);
+			free(r);
+		} else {
+			rp = &r->next;
+		}
+	}
+}
+
+/**
+ * Announces that this thread is about to probe a shared table, registering the
+ * thread as a reader the first time.
+ */
+static void enter_epoch(void)
+{
+	Reader *r;
+
+	if (!self) {
+		pthread_once(&reader_once, make_reader_key);
+		pthread_mutex_lock(&readers_lock);
+		for (r = readers; r && r->in_use; r = r->next) {
+		}
+		if (!r) {
+			if (!(r = malloc(sizeof(Reader)))) {
+				pthread_mutex_unlock(&readers_lock);
+				fprintf(stderr, "out of memory for hash table reader\n");
+				abort();
+			}
+			r->epoch = 0;
+			r->next = readers;
+			__atomic_store_n(&readers, r, __ATOMIC_RELEASE);
+		}
+		r->in_use = 1;
+		pthread_mutex_unlock(&readers_lock);
+		pthread_setspecific(reader_key, r);
+		self = r;
+	}
+
+	__atomic_store_n(&self->epoch,
+			__atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
+
+static void leave_epoch(void)
+{
+	__atomic_store_n(&self->epoch, 0, __ATOMIC_RELEASE);
+}
+
+static void make_reader_key(void)
+{
+	pthread_key_create(&reader_key, release_reader);
+}
+
+/**
+ * Hands the reader record of an exiting thread back to the registry.
+ */
+static void release_reader(void *r)
+{
+	pthread_mutex_lock(&readers_lock);
+	((Reader *) r)->epoch = 0;
+	((Reader *) r)->in_use = 0;
+	pthread_mutex_unlock(&readers_lock);
+}
+
+Boolean ht_delete(HashTab *ht, void *key, void **value)
+{
+	unsigned int hash;
+	Slot *s;
+	Boolean found = FALSE;
+	unsigned int last;
+
+	if (ht->frozen) {
+		return FALSE;
+	}
+
+	hash = full_hash(ht, key);
+	if (IS_SMALL(ht)) {
+		if (!(s = find_small(ht, key, hash))) {
+			return FALSE;
+		}
+		if (value) {
+			*value = s->value;
+		}
+		/* fill the hole with the last entry */
+		last = --ht->num_entries;
+		ht->small_hash[s - ht->small] = ht->small_hash[last];
+		*s = ht->small[last];
+		return TRUE;
+	}
+
+	if (ht->migrated < ht->old.capacity) {
+		migrate(ht, MIGRATE_SLOTS);
+	}
+
+	if ((s = find_slot(ht, &ht->cur, key, hash))) {
+		if (value) {
+			*value = s->value;
+		}
+		if (erase(&ht->cur, s)) {
+			ht->num_deleted++;
+		}
+		found = TRUE;
+	}
+
+	/* the entry may also still be in the old array, whether or not it has
+	 * been copied already */
+	if (ht->migrated < ht->old.capacity
+			&& (s = find_slot(ht, &ht->old, key, hash))) {
+		if (value && !found) {
+			*value = s->value;
+		}
+		erase(&ht->old, s);
+		found = TRUE;
+	}
+
+	if (found) {
+		ht->num_entries--;
+	}
+
+	return found;
+}
+
+void ht_clear(HashTab *ht, void (*freekey)(void *k), void (*freeval)(void *v))
+{
+	Slab *s, *next;
+
+	visit(ht, freekey, freeval);
+
+	/* keep the first slab for reuse */
+	if ((s = ht->slab)) {
+		while (s->next) {
+			next = s->next->next;
+			free(s->next);
+			s->next = next;
+		}
+		s->used = 0;
+	}
+
+	free_slots(&ht->old);
+	ht->migrated = 0;
+	ht->num_entries = ht->num_deleted = 0;
+	if (ht->frozen) {
+		/* thaw into an empty table; shared tables need slots to publish */
+		free(ht->frozen);
+		ht->frozen = NULL;
+		ht->max_entries = SMALL_ENTRIES;
+		if (ht->shared || ht->fixed) {
+			if (!promote(ht, INITIAL_CAPACITY)) {
+				fprintf(stderr, "out of memory for hash table slots\n");
+				abort();
+			}
+			if (ht->shared) {
+				*ht->published = ht->cur;
 			}
 		}
+	} else if (!IS_SMALL(ht)) {
+		memset(ht->cur.ctrl, CTRL_EMPTY, ht->cur.capacity);
+	}
+}
+
+int ht_freeze(HashTab *ht)
+{
+	unsigned int n = ht->num_entries, nb = n / FROZEN_BUCKET + 1, i;
+	size_t keysize = ht->fixed ? HT_FIXED_KEY_SIZE : 0;
+	unsigned char *keys;
+	unsigned int *first;
+	unsigned char *taken;
+	Slot *entries;
+	Frozen *f;
+	int ret = HASH_TABLE_NO_SPACE_FOR_NODE;
+
+	if (ht->frozen) {
+		return EXIT_SUCCESS;
+	}
+
+	f = malloc(sizeof(Frozen) + n * (sizeof(Slot) + keysize)
+			+ nb * sizeof(unsigned int));
+	entries = malloc((n + 1) * sizeof(Slot));
+	first = malloc((nb + 1) * sizeof(unsigned int));
+	taken = calloc(n + 1, 1);
+	if (f && entries && first && taken) {
+		f->size = n;
+		f->nbuckets = nb;
+		f->seeds = (unsigned int *) (f->slots + n);
+		ret = seed_buckets(ht, f, entries, first, taken);
+	}
+	free(entries);
+	free(first);
+	free(taken);
+	if (ret != EXIT_SUCCESS) {
+		free(f);
+		return ret;
+	}
+
+	/* fixed-width keys move along, after the seeds */
+	keys = (unsigned char *) (f->seeds + nb);
+	for (i = 0; i < n && ht->fixed; i++) {
+		memcpy(keys + i * keysize, f->slots[i].key, keysize);
+		f->slots[i].key = keys + i * keysize;
+	}
+
+	free_slots(&ht->cur);
+	free_slots(&ht->old);
+	ht->migrated = ht->num_deleted = 0;
+	ht->frozen = f;
+
+	return EXIT_SUCCESS;
+}
+
+Boolean ht_foreach(HashTab *ht, unsigned int *cursor, void **key,
+		void **value)
+{
+	unsigned int i;
+
+	if (ht->frozen) {
+		if (*cursor >= ht->frozen->size) {
+			return FALSE;
+		}
+		*key = ht->frozen->slots[*cursor].key;
+		*value = ht->frozen->slots[(*cursor)++].value;
+		return TRUE;
+	}
+	if (IS_SMALL(ht)) {
+		if (*cursor >= ht->num_entries) {
+			return FALSE;
+		}
+		*key = ht->small[*cursor].key;
+		*value = ht->small[(*cursor)++].value;
+		return TRUE;
+	}
+
+	if (*cursor == 0) {
+		migrate(ht, ht->old.capacity);
+	}
+
+	while ((i = (*cursor)++) < ht->cur.capacity) {
+		if (IS_FULL(ht->cur.ctrl[i])) {
+			*key = ht->cur.slots[i].key;
+			*value = ht->cur.slots[i].value;
+			return TRUE;
+		}
 	}
+	*cursor = ht->cur.capacity;
+
+	return FALSE;
+}
+
+Boolean ht_free(HashTab *ht, void (*freekey)(void *k), void (*freeval)(void *v))
+{
+	Slab *s;
 
-	/* free the table and container */
-	/* TODO */
-	free(ht->table);
+	visit(ht, freekey, freeval);
+
+	while ((s = ht->slab)) {
+		ht->slab = s->next;
+		free(s);
+	}
+	if (ht->shared) {
+		reclaim(ht, TRUE);
+		pthread_mutex_destroy(&ht->lock);
+	}
+	free(ht->published);
+	free(ht->frozen);
+	free_slots(&ht->cur);
+	free_slots(&ht->old);
 	free(ht);
-	ht->table = NULL;
-	ht = NULL;
 
 	return EXIT_SUCCESS;
 }
 
+void *ht_alloc(HashTab *ht, size_t n)
+{
+	Slab *s;
+	size_t size;
+
+	if (ht->shared) {
+		pthread_mutex_lock(&ht->lock);
+	}
+
+	n = (n + SLAB_ALIGN - 1) & ~(size_t) (SLAB_ALIGN - 1);
+	if (!(s = ht->slab) || s->size - s->used < n) {
+		size = (n > SLAB_SIZE) ? n : SLAB_SIZE;
+		if (!(s = malloc(sizeof(Slab) + size))) {
+			if (ht->shared) {
+				pthread_mutex_unlock(&ht->lock);
+			}
+			return NULL;
+		}
+		s->size = size;
+		s->used = 0;
+
+		/* an oversized request gets a slab of its own, behind the current one,
+		 * which may still have room for smaller requests */
+		if (size > SLAB_SIZE && ht->slab) {
+			s->next = ht->slab->next;
+			ht->slab->next = s;
+		} else {
+			s->next = ht->slab;
+			ht->slab = s;
+		}
+	}
+
+	s->used += n;
+	if (ht->shared) {
+		pthread_mutex_unlock(&ht->lock);
+	}
+
+	return s->data + s->used - n;
+}
+
 void ht_print(HashTab *ht, void (*keyval2str)(void *k, void *v, char *b))
 {
 	unsigned int i;
-	HTentry *p;
 	char buffer[PRINT_BUFFER_SIZE];
+	Slot *s;
+
+	if (IS_SMALL(ht) || ht->frozen) {
+		for (i = 0; i < ht->num_entries; i++) {
+			s = ht->frozen ? &ht->frozen->slots[i] : &ht->small[i];
+			keyval2str(s->key, s->value, buffer);
+			printf("bucket[%2i] --> %s --> NULL\n", i, buffer);
+		}
+		return;
+	}
 
-	/* TODO: This function is complete and useful for testing, but you have to
-	 * write your own keyval2str if you want to use it.
-	 */
+	/* show every entry in its final place */
+	migrate(ht, ht->old.capacity);
 
-	for (i = 0; i < ht->size; i++) {
+	for (i = 0; i < ht->cur.capacity; i++) {
 		printf("bucket[%2i]", i);
-		for (p = ht->table[i]; p != NULL; p = p->next_ptr) {
-			keyval2str(p->key, p->value, buffer);
+		if (IS_FULL(ht->cur.ctrl[i])) {
+			keyval2str(ht->cur.slots[i].key, ht->cur.slots[i].value, buffer);
 			printf(" --> %s", buffer);
 		}
 		printf(" --> NULL\n");
 	}
 }
 
+void ht_stats(HashTab *ht, HTstats *stats)
+{
+	unsigned long total = 0;
+	size_t keysize;
+	Slab *s;
+
+	memset(stats, 0, sizeof(HTstats));
+	stats->entries = ht->num_entries;
+	stats->capacity = ht->frozen ? ht->frozen->size
+		: IS_SMALL(ht) ? SMALL_ENTRIES : ht->cur.capacity;
+	stats->tombstones = ht->num_deleted;
+	stats->loadfactor = stats->capacity
+		? (float) ht->num_entries / stats->capacity : 0;
+	stats->rehashes = ht->rehashes;
+	stats->hits = ht->hits;
+	stats->misses = ht->misses;
+
+	if (IS_SMALL(ht) || ht->frozen) {
+		/* a small table is scanned, and a frozen one probed, in one step */
+		stats->max_probe = ht->num_entries ? 1 : 0;
+		stats->probes[0] = total = ht->num_entries;
+	}
+	probe_stats(&ht->cur, 0, stats, &total);
+	probe_stats(&ht->old, ht->migrated, stats, &total);
+	stats->mean_probe = ht->num_entries ? (float) total / ht->num_entries : 0;
+
+	keysize = ht->fixed ? HT_FIXED_KEY_SIZE : 0;
+	stats->bytes = sizeof(HashTab)
+		+ (ht->frozen ? sizeof(Frozen) + ht->frozen->size
+				* (sizeof(Slot) + keysize)
+				+ ht->frozen->nbuckets * sizeof(unsigned int) : 0)
+		+ (size_t) ht->cur.capacity * (sizeof(Slot) + keysize + 1)
+		+ (size_t) ht->old.capacity * (sizeof(Slot) + keysize + 1);
+	for (s = ht->slab; s; s = s->next) {
+		stats->bytes += sizeof(Slab) + s->size;
+	}
+}
+
+void ht_print_stats(HashTab *ht, const char *name, FILE *out)
+{
+	HTstats st;
+
+	ht_stats(ht, &st);
+	ht_report_stats(&st, name, out);
+}
+
+void ht_report_stats(const HTstats *st, const char *name, FILE *out)
+{
+	unsigned int i;
+	const char *sep = " ";
+
+	fprintf(out, "%s: %u entries in %u slots (load %.2f), %u tombstones, "
+			"%u rehashes, %lu bytes\n", name, st->entries, st->capacity,
+			st->loadfactor, st->tombstones, st->rehashes,
+			(unsigned long) st->bytes);
+	fprintf(out, "  lookups: %lu hits, %lu misses\n", st->hits, st->misses);
+	fprintf(out, "  probes: max %u, mean %.2f;", st->max_probe,
+			st->mean_probe);
+	for (i = 0; i < HT_STATS_PROBES; i++) {
+		if (st->probes[i] > 0) {
+			fprintf(out, "%s%s%u: %u", sep,
+					(i == HT_STATS_PROBES - 1) ? ">=" : "", i + 1,
+					st->probes[i]);
+			sep = ", ";
+		}
+	}
+	fprintf(out, "\n");
+}
+
+/* --- hash functions ------------------------------------------------------- */
+
+unsigned int ht_hash_fnv1a(void *key, unsigned int size)
+{
+	const unsigned char *p = key;
+	unsigned int hash = FNV_OFFSET;
+
+	while (*p) {
+		hash = (hash ^ *p++) * FNV_PRIME;
+	}
+
+	return hash % size;
+}
+
+unsigned int ht_hash_wy(void *key, unsigned int size)
+{
+	const unsigned char *p = key;
+	unsigned long long a, b, seed, len, i;
+
+	len = strlen(key);
+	seed = WY_P0;
+	if (len <= 16) {
+		if (len >= 4) {
+			a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+			b = (read4(p + len - 4) << 32)
+				| read4(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = ((unsigned long long) p[0] << 16)
+				| ((unsigned long long) p[len >> 1] << 8) | p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		for (i = len; i > 16; i -= 16, p += 16) {
+			seed = mum(read8(p) ^ WY_P1, read8(p + 8) ^ seed);
+		}
+		a = read8(p + i - 16);
+		b = read8(p + i - 8);
+	}
+	a = mum(mum(a ^ WY_P1, b ^ seed), len ^ WY_P1);
+
+	return (unsigned int) (a ^ (a >> 32)) % size;
+}
+
+unsigned int ht_hash_fixed(void *key, unsigned int size)
+{
+	const unsigned char *p = key;
+	unsigned long long h;
+
+	h = mum(read8(p) ^ WY_P0, read8(p + 8) ^ WY_P1)
+		^ mum(read8(p + 16) ^ WY_P2, read8(p + 24) ^ WY_P3);
+	h = mum(h, WY_P1);
+
+	return (unsigned int) (h ^ (h >> 32)) % size;
+}
+
 /* --- utility functions ---------------------------------------------------- */
 
-/* TODO: I suggest completing the following helper functions for use in the
- * global functions ("exported" as part of this unit's public API) given above.
- * You may, however, elect not to use them, and then go about it in your own way
- * entirely.  The ball is in your court, so to speak, but remember: I have
- * suggested using these functions for a reason -- they should make your life
- * easier.
+/**
+ * Asks the user hash function for a full-width hash, and mixes it so that
+ * both the tag in the low bits and the group index in the high bits depend on
+ * every bit of the original.
+ */
+static unsigned int full_hash(HashTab *ht, void *key)
+{
+	unsigned int h = ht->hash(key, UINT_MAX);
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+
+	return h;
+}
+
+/**
+ * Finds the slot of the specified key in the current array, or in the array
+ * being migrated, and moves the migration along by one step.
+ */
+static Slot *lookup(HashTab *ht, void *key, unsigned int hash)
+{
+	Slot *s;
+
+	if (ht->frozen) {
+		return find_frozen(ht, key, hash);
+	}
+	if (IS_SMALL(ht)) {
+		return find_small(ht, key, hash);
+	}
+
+	if (ht->migrated < ht->old.capacity) {
+		migrate(ht, MIGRATE_SLOTS);
+	}
+
+	if (!(s = find_slot(ht, &ht->cur, key, hash))
+			&& ht->migrated < ht->old.capacity) {
+		s = find_slot(ht, &ht->old, key, hash);
+	}
+
+	return s;
+}
+
+/**
+ * Probes the groups of the slot array, starting at the group selected by the
+ * high bits of the hash, and stepping by triangular numbers, which visits
+ * every group exactly once for a power-of-two number of groups.
+ */
+static Slot *find_slot(HashTab *ht, SlotArray *a, void *key,
+		unsigned int hash)
+{
+	unsigned int g, step, mask, groups, i;
+	const signed char *group;
+
+	groups = a->capacity / GROUP_WIDTH - 1;
+	for (g = (hash >> 7) & groups, step = 0; ; g = (g + ++step) & groups) {
+		group = a->ctrl + g * GROUP_WIDTH;
+		for (mask = match_tag(group, hash & 0x7f); mask; mask &= mask - 1) {
+			i = g * GROUP_WIDTH + __builtin_ctz(mask);
+			/* the acquire load pairs with the release store of the tag in
+			 * put, so that the slot is seen filled in */
+			if (__atomic_load_n(&a->ctrl[i], __ATOMIC_ACQUIRE) >= 0
+					&& a->slots[i].hash == hash
+					&& keys_equal(ht, key, a->slots[i].key)) {
+				return &a->slots[i];
+			}
+		}
+		if (match_tag(group, CTRL_EMPTY)) {
+			return NULL;
+		}
+	}
+}
+
+/**
+ * Returns the index of the first empty or deleted slot along the probe
+ * sequence of the specified hash.  The load factor guarantees that there is
+ * one.
+ */
+static unsigned int free_slot(SlotArray *a, unsigned int hash)
+{
+	unsigned int g, step, mask, groups;
+
+	groups = a->capacity / GROUP_WIDTH - 1;
+	for (g = (hash >> 7) & groups, step = 0; ; g = (g + ++step) & groups) {
+		if ((mask = match_free(a->ctrl + g * GROUP_WIDTH))) {
+			return g * GROUP_WIDTH + __builtin_ctz(mask);
+		}
+	}
+}
+
+/**
+ * Stores an entry in the first free slot of its probe sequence in the current
+ * array.
+ */
+static void put(HashTab *ht, void *key, void *value, unsigned int hash)
+{
+	unsigned int i;
+
+	i = free_slot(&ht->cur, hash);
+	if (ht->cur.ctrl[i] == CTRL_DELETED) {
+		ht->num_deleted--;
+	}
+	if (ht->fixed) {
+		memcpy(ht->cur.keys + (size_t) i * HT_FIXED_KEY_SIZE, key,
+				HT_FIXED_KEY_SIZE);
+		key = ht->cur.keys + (size_t) i * HT_FIXED_KEY_SIZE;
+	}
+	ht->cur.slots[i].key = key;
+	ht->cur.slots[i].value = value;
+	ht->cur.slots[i].hash = hash;
+	__atomic_store_n(&ht->cur.ctrl[i], (signed char) (hash & 0x7f),
+			__ATOMIC_RELEASE);
+}
+
+/**
+ * Marks the specified slot as free, and returns whether it had to be marked
+ * with a tombstone.
+ */
+static Boolean erase(SlotArray *a, Slot *s)
+{
+	unsigned int i = s - a->slots;
+
+	if (match_tag(a->ctrl + (i & ~(GROUP_WIDTH - 1)), CTRL_EMPTY)) {
+		a->ctrl[i] = CTRL_EMPTY;
+		return FALSE;
+	}
+
+	a->ctrl[i] = CTRL_DELETED;
+	return TRUE;
+}
+
+/**
+ * Calls the release functions, either of which may be NULL, on every entry.
+ */
+static void visit(HashTab *ht, void (*freekey)(void *k),
+		void (*freeval)(void *v))
+{
+	unsigned int i;
+
+	if (ht->fixed) {
+		freekey = NULL;
+	}
+	if (!freekey && !freeval) {
+		return;
+	}
+
+	for (i = 0; IS_SMALL(ht) && i < ht->num_entries; i++) {
+		if (freekey) {
+			freekey(ht->small[i].key);
+		}
+		if (freeval) {
+			freeval(ht->small[i].value);
+		}
+	}
+	for (i = 0; ht->frozen && i < ht->frozen->size; i++) {
+		if (freekey) {
+			freekey(ht->frozen->slots[i].key);
+		}
+		if (freeval) {
+			freeval(ht->frozen->slots[i].value);
+		}
+	}
+
+	migrate(ht, ht->old.capacity);
+	for (i = 0; i < ht->cur.capacity; i++) {
+		if (IS_FULL(ht->cur.ctrl[i])) {
+			if (freekey) {
+				freekey(ht->cur.slots[i].key);
+			}
+			if (freeval) {
+				freeval(ht->cur.slots[i].value);
+			}
+		}
+	}
+}
+
+/**
+ * Allocates a slot array of the specified capacity as the current array.  The
+ * slots and their control bytes share one block, with the control bytes last.
+ */
+static Boolean alloc_slots(HashTab *ht, unsigned int capacity)
+{
+	size_t keysize = ht->fixed ? HT_FIXED_KEY_SIZE : 0;
+	signed char *ctrl;
+	Slot *slots;
+
+	if (!(slots = malloc(capacity * (sizeof(Slot) + keysize + 1)))) {
+		return FALSE;
+	}
+
+	ctrl = (signed char *) (slots + capacity) + capacity * keysize;
+	memset(ctrl, CTRL_EMPTY, capacity);
+	ht->cur.ctrl = ctrl;
+	ht->cur.slots = slots;
+	ht->cur.keys = ht->fixed ? (unsigned char *) (slots + capacity) : NULL;
+	ht->cur.capacity = capacity;
+	ht->num_deleted = 0;
+	ht->max_entries = capacity * ht->max_loadfactor;
+	if (ht->max_entries == 0) {
+		ht->max_entries = 1;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Moves the entries of a small table to a slot array of the specified
+ * capacity.  If the array cannot be allocated, the table is left as it was.
+ */
+static Boolean promote(HashTab *ht, unsigned int capacity)
+{
+	unsigned int i;
+
+	if (!alloc_slots(ht, capacity)) {
+		return FALSE;
+	}
+
+	for (i = 0; i < ht->num_entries; i++) {
+		put(ht, ht->small[i].key, ht->small[i].value, ht->small[i].hash);
+	}
+
+	return TRUE;
+}
+
+/**
+ * Finds the entry of the specified key in a small table.
+ */
+static Slot *find_small(HashTab *ht, void *key, unsigned int hash)
+{
+	unsigned int mask;
+	Slot *s;
+
+	for (mask = match_small(ht, hash); mask; mask &= mask - 1) {
+		s = &ht->small[__builtin_ctz(mask)];
+		if (ht->cmp(key, s->key) == 0) {
+			return s;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Computes the perfect hash of the entries of a table into the specified
+ * frozen table, using the scratch arrays for the entries sorted by bucket, the
+ * index of the first entry of every bucket, and the slots already taken.
+ */
+static int seed_buckets(HashTab *ht, Frozen *f, Slot *entries,
+		unsigned int *first, unsigned char *taken)
+{
+	unsigned int nb = f->nbuckets, i, k, b, size, max = 0;
+	void *key, *value;
+
+	for (i = 0, k = 0; ht_foreach(ht, &k, &key, &value); i++) {
+		entries[i].key = key;
+		entries[i].value = value;
+		entries[i].hash = full_hash(ht, key);
+	}
+
+	/* buckets are ranges of hashes, so sorting by hash groups them, and
+	 * brings together the keys that no seed can tell apart */
+	qsort(entries, f->size, sizeof(Slot), cmp_hash);
+	memset(first, 0, (nb + 1) * sizeof(unsigned int));
+	for (i = 0; i < f->size; i++) {
+		if (i > 0 && entries[i].hash == entries[i - 1].hash) {
+			return HASH_TABLE_NO_PERFECT_HASH;
+		}
+		first[reduce(entries[i].hash, nb) + 1]++;
+	}
+	for (b = 0; b < nb; b++) {
+		max = (first[b + 1] > max) ? first[b + 1] : max;
+		first[b + 1] += first[b];
+	}
+
+	/* seed the largest buckets first, while most slots are still free */
+	memset(f->seeds, 0, nb * sizeof(unsigned int));
+	for (size = max; size > 0; size--) {
+		for (b = 0; b < nb; b++) {
+			if (first[b + 1] - first[b] == size
+					&& !place_bucket(f, entries + first[b], size, taken,
+						&f->seeds[b])) {
+				return HASH_TABLE_NO_PERFECT_HASH;
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Finds the first seed that sends every entry of a bucket to a slot not yet
+ * taken, and moves the entries there.
+ */
+static Boolean place_bucket(Frozen *f, Slot *members, unsigned int n,
+		unsigned char *taken, unsigned int *seed)
+{
+	unsigned long limit = (unsigned long) FROZEN_TRIES * (f->size + 16);
+	unsigned int s, i;
+
+	for (s = 0; s < limit; s++) {
+		for (i = 0; i < n; i++) {
+			if (taken[reduce(seeded(members[i].hash, s), f->size)]) {
+				break;
+			}
+			taken[reduce(seeded(members[i].hash, s), f->size)] = 1;
+		}
+		if (i == n) {
+			for (i = 0; i < n; i++) {
+				f->slots[reduce(seeded(members[i].hash, s), f->size)]
+					= members[i];
+			}
+			*seed = s;
+			return TRUE;
+		}
+		while (i-- > 0) {
+			taken[reduce(seeded(members[i].hash, s), f->size)] = 0;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * Finds the entry of the specified key in a frozen table, in its one possible
+ * slot.
+ */
+static Slot *find_frozen(HashTab *ht, void *key, unsigned int hash)
+{
+	Frozen *f = ht->frozen;
+	Slot *s;
+
+	if (f->size == 0) {
+		return NULL;
+	}
+
+	s = &f->slots[reduce(seeded(hash,
+					f->seeds[reduce(hash, f->nbuckets)]), f->size)];
+	return (s->hash == hash && keys_equal(ht, key, s->key)) ? s : NULL;
+}
+
+/**
+ * Rehashes a full hash with the seed of its bucket.
+ */
+static unsigned int seeded(unsigned int hash, unsigned int seed)
+{
+	hash ^= seed * 0x9e3779b9U;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+/**
+ * Maps a hash onto 0..n-1 by its high bits, without a division.
+ */
+static unsigned int reduce(unsigned int hash, unsigned int n)
+{
+	return (unsigned int) (((unsigned long long) hash * n) >> 32);
+}
+
+static int cmp_hash(const void *a, const void *b)
+{
+	unsigned int x = ((const Slot *) a)->hash, y = ((const Slot *) b)->hash;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Compares a key with a stored key, as blocks if the keys are of fixed width,
+ * and otherwise with the comparison function of the table.
+ */
+static Boolean keys_equal(HashTab *ht, void *key, void *stored)
+{
+	if (!ht->fixed) {
+		return ht->cmp(key, stored) == 0;
+	}
+
+#if defined(HAVE_AVX2_KEYS) && HT_FIXED_KEY_SIZE == 32
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_loadu_si256((const __m256i *) key),
+				_mm256_loadu_si256((const __m256i *) stored))) == -1;
+#elif defined(HAVE_SSE2_GROUPS) && HT_FIXED_KEY_SIZE == 32
+	{
+		const __m128i *a = key, *b = stored;
+
+		return (_mm_movemask_epi8(_mm_and_si128(
+						_mm_cmpeq_epi8(_mm_loadu_si128(a), _mm_loadu_si128(b)),
+						_mm_cmpeq_epi8(_mm_loadu_si128(a + 1),
+							_mm_loadu_si128(b + 1)))) == 0xffff);
+	}
+#else
+	return memcmp(key, stored, HT_FIXED_KEY_SIZE) == 0;
+#endif
+}
+
+/**
+ * The comparison function of tables with fixed-width keys, which compares
+ * padded blocks; the table compares them itself, through keys_equal.
+ */
+static int cmp_fixed(void *val1, void *val2)
+{
+	return memcmp(val1, val2, HT_FIXED_KEY_SIZE);
+}
+
+/**
+ * Returns the smallest number of slots that holds the specified number of
+ * entries within the maximum load factor, and no less than INITIAL_CAPACITY.
+ */
+static unsigned int capacity_for(HashTab *ht, unsigned int n)
+{
+	unsigned int capacity = INITIAL_CAPACITY;
+
+	while ((unsigned int) (capacity * ht->max_loadfactor) < n
+			&& capacity <= UINT_MAX / 4) {
+		capacity *= 2;
+	}
+
+	return capacity;
+}
+
+/**
+ * Replaces the slot array by a fresh one, and keeps the old one for migration.
+ * The new array is twice the size, unless at least half of the used slots are
+ * tombstones, which are dropped by the migration.  Migration normally ends
+ * long before the new array fills up; only for load factors below
+ * 1 / MIGRATE_SLOTS must an earlier migration still be completed here.  If the
+ * new array cannot be allocated, the table is left as it was.
+ */
+static Boolean rehash(HashTab *ht)
+{
+	SlotArray a;
+	unsigned int capacity;
+
+	migrate(ht, ht->old.capacity);
+
+	a = ht->cur;
+	capacity = (ht->num_deleted >= ht->num_entries)
+		? a.capacity : a.capacity * 2;
+	if (capacity < a.capacity) {
+		return FALSE;
+	}
+	if (ht->shared) {
+		return rehash_shared(ht, capacity);
+	}
+	if (!alloc_slots(ht, capacity)) {
+		return FALSE;
+	}
+
+	ht->old = a;
+	ht->migrated = 0;
+	ht->rehashes++;
+
+	return TRUE;
+}
+
+/**
+ * Moves all entries, at once, to a fresh slot array of the specified capacity.
+ * If the new array cannot be allocated, the table is left as it was.
  */
+static Boolean resize(HashTab *ht, unsigned int capacity)
+{
+	SlotArray a;
+
+	migrate(ht, ht->old.capacity);
 
-static int getsize(HashTab *ht)
+	a = ht->cur;
+	if (!alloc_slots(ht, capacity)) {
+		return FALSE;
+	}
+
+	ht->old = a;
+	ht->migrated = 0;
+	ht->rehashes++;
+	migrate(ht, a.capacity);
+
+	return TRUE;
+}
+
+/**
+ * Copies up to the specified number of slots of the old array to the current
+ * one, and releases the old array once all its slots have been copied.
+ */
+static void migrate(HashTab *ht, unsigned int nslots)
 {
-	/* TODO: Compute the current prime size of the hash table. */
-	int start_size = 1;
-	for (int i = 0; i < ht->idx; i++) {
-		start_size *= 2;
+	unsigned int i, end;
+	SlotArray *old = &ht->old;
+
+	if (ht->migrated >= old->capacity) {
+		return;
 	}
-	start_size -= delta[ht->idx];
 
-	return start_size;
+	end = old->capacity - ht->migrated > nslots
+		? ht->migrated + nslots : old->capacity;
+	for (i = ht->migrated; i < end; i++) {
+		if (IS_FULL(old->ctrl[i])) {
+			put(ht, old->slots[i].key, old->slots[i].value,
+					old->slots[i].hash);
+		}
+	}
+	ht->migrated = end;
+
+	if (ht->migrated == old->capacity) {
+		free_slots(old);
+		ht->migrated = 0;
+	}
 }
 
-static void rehash(HashTab *ht)
+/**
+ * Adds the probe lengths of the entries in the specified slot array, from the
+ * specified slot on, to the statistics.
+ */
+static void probe_stats(SlotArray *a, unsigned int from, HTstats *stats,
+		unsigned long *total)
 {
-	/* TODO: Rehash the hash table by
-	 * (1) allocating a new table that uses as size the next prime in the
-	 *     "almost-double" array,
-	 * (2) moving the entries in the existing tables to appropriate positions in
-	 *     the new table, and
-	 * (3) freeing the old table.
-	 */
-	HTentry *p;	
-	ht->idx++;
-	
-	HashTab *nht = (HashTab *)malloc(sizeof(HashTab));
-	nht->max_loadfactor = ht->max_loadfactor;
-	nht->idx = ht->idx;
-	nht->size = getsize(nht);
-	nht->hash = ht->hash;
-	nht->cmp = ht->cmp;
-	nht->table = (HTentry **)malloc(sizeof(HTentry) * nht->size);
+	unsigned int i, n;
 
-	for (unsigned int i = 0; i < ht->size; i++) {
-		for (p = ht->table[i]; p != NULL; p = p->next_ptr) {
-			ht_insert(nht, p->key, p->value);
+	for (i = from; i < a->capacity; i++) {
+		if (IS_FULL(a->ctrl[i])) {
+			n = probe_length(a, i);
+			*total += n;
+			if (n > stats->max_probe) {
+				stats->max_probe = n;
+			}
+			stats->probes[(n < HT_STATS_PROBES ? n : HT_STATS_PROBES) - 1]++;
 		}
 	}
+}
+
+/**
+ * Returns the number of groups a search for the entry in the specified slot
+ * probes, counting its home group as one.
+ */
+static unsigned int probe_length(SlotArray *a, unsigned int i)
+{
+	unsigned int g, step, groups;
+
+	groups = a->capacity / GROUP_WIDTH - 1;
+	g = (a->slots[i].hash >> 7) & groups;
+	step = 0;
+	while (g != i / GROUP_WIDTH) {
+		g = (g + ++step) & groups;
+	}
 
-	ht_free(ht, &freekey, &freeval);
+	return step + 1;
+}
 
-	ht = (HashTab *)malloc(sizeof(HashTab));
-	*ht = *nht;
+static void free_slots(SlotArray *a)
+{
+	if (a->capacity > 0) {
+		free(a->slots);
+		a->capacity = 0;
+	}
 }
 
-static void freekey(void *k)
+/**
+ * Returns a bit mask with bit i set for every control byte i in the group of
+ * GROUP_WIDTH bytes that equals the specified tag.
+ */
+static unsigned int match_tag(const signed char *group, signed char tag)
 {
-	k = NULL;
-	free(k);
+#ifdef HAVE_SSE2_GROUPS
+	__m128i g = _mm_loadu_si128((const __m128i *) group);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(tag)));
+#else
+	unsigned int i, mask = 0;
+
+	for (i = 0; i < GROUP_WIDTH; i++) {
+		if (group[i] == tag) {
+			mask |= 1U << i;
+		}
+	}
+
+	return mask;
+#endif
 }
 
-static void freeval(void *v)
+/**
+ * Returns a bit mask with bit i set for every control byte i in the group of
+ * GROUP_WIDTH bytes that marks an empty or deleted slot, that is, that has its
+ * sign bit set.
+ */
+static unsigned int match_free(const signed char *group)
 {
-	v = NULL;
-	free(v);
+#ifdef HAVE_SSE2_GROUPS
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) group));
+#else
+	unsigned int i, mask = 0;
+
+	for (i = 0; i < GROUP_WIDTH; i++) {
+		if (group[i] < 0) {
+			mask |= 1U << i;
+		}
+	}
+
+	return mask;
+#endif
 }
 
-int ht_find_id(HashTab *ht, void *key, void **value)
+/**
+ * Returns a bit mask with bit i set for every entry i of a small table whose
+ * hash equals the specified hash.
+ */
+static unsigned int match_small(HashTab *ht, unsigned int hash)
 {
-	HTentry *p;
-	char *c;
-	c = "simon";
-	int k = ht->hash(key, ht->size);
-	k = 3;
-	key = &c;
-	printf("key equals %s\n", (char*)key);
-	for (p = ht->table[k]; p != NULL; p = p->next_ptr) {
-		if (ht->cmp(p->key, key) == 0) {
-			*value = p->value;
-			return 1;
-		}	
+	unsigned int mask;
+#ifdef HAVE_SSE2_GROUPS
+	__m128i h = _mm_set1_epi32((int) hash);
+	const __m128i *p = (const __m128i *) ht->small_hash;
+
+	mask = _mm_movemask_ps(_mm_castsi128_ps(
+				_mm_cmpeq_epi32(_mm_loadu_si128(p), h)))
+		| _mm_movemask_ps(_mm_castsi128_ps(
+				_mm_cmpeq_epi32(_mm_loadu_si128(p + 1), h))) << 4;
+#else
+	unsigned int i;
+
+	for (mask = i = 0; i < SMALL_ENTRIES; i++) {
+		if (ht->small_hash[i] == hash) {
+			mask |= 1U << i;
+		}
 	}
+#endif
+
+	/* the hashes past the last entry are stale */
+	return mask & ((1U << ht->num_entries) - 1);
+}
+
+/**
+ * Multiplies two 64-bit words to 128 bits, and folds the halves together.
+ */
+static unsigned long long mum(unsigned long long a, unsigned long long b)
+{
+#ifdef __SIZEOF_INT128__
+	__extension__ unsigned __int128 r = (unsigned __int128) a * b;
 
-	return 0;
+	return (unsigned long long) r ^ (unsigned long long) (r >> 64);
+#else
+	unsigned long long ha = a >> 32, la = (unsigned int) a;
+	unsigned long long hb = b >> 32, lb = (unsigned int) b;
+	unsigned long long mid0 = ha * lb, mid1 = la * hb;
+	unsigned long long lo, hi, t;
 
+	t = la * lb;
+	lo = t + (mid0 << 32);
+	hi = ha * hb + (mid0 >> 32) + (mid1 >> 32) + (lo < t);
+	t = lo;
+	lo += mid1 << 32;
+	hi += lo < t;
+
+	return lo ^ hi;
+#endif
 }
 
+static unsigned long long read8(const unsigned char *p)
+{
+	unsigned long long v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
 
+static unsigned long long read4(const unsigned char *p)
+{
+	unsigned int v;
 
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
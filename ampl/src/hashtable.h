@@ -9,16 +9,47 @@
 #ifndef HASH_TABLE_H
 #define HASH_TABLE_H
 
+#include <stddef.h>
+#include <stdio.h>
 #include "boolean.h"
 
 /* --- error return codes --------------------------------------------------- */
 
 #define HASH_TABLE_KEY_VALUE_PAIR_EXISTS -1
 #define HASH_TABLE_NO_SPACE_FOR_NODE     -2
+#define HASH_TABLE_FROZEN                -3
+#define HASH_TABLE_NO_PERFECT_HASH       -4
+
+/* --- hash functions ------------------------------------------------------- */
+
+/** the width of the keys hashed by <code>ht_hash_fixed</code>; the same as
+ * <code>MAX_ID_LENGTH</code> in token.h                                     */
+#define HT_FIXED_KEY_SIZE 32
+
+/** the number of probe lengths told apart by the statistics; longer probes
+ * are counted with the last                                                 */
+#define HT_STATS_PROBES 8
 
 /** the container structure for a hash table */
 typedef struct hashtab HashTab;
 
+/** a snapshot of the shape and usage of a hash table */
+typedef struct {
+	unsigned int  entries;     /*<< the number of entries                     */
+	unsigned int  capacity;    /*<< the number of slots                       */
+	unsigned int  tombstones;  /*<< the number of slots of deleted entries    */
+	float         loadfactor;  /*<< entries per slot                          */
+	unsigned int  rehashes;    /*<< the number of slot array replacements     */
+	unsigned int  max_probe;   /*<< the most groups probed to find an entry   */
+	float         mean_probe;  /*<< the mean groups probed to find an entry   */
+	/** the number of entries found after probing 1, 2, ... groups; typed
+	 * tables probe single slots rather than groups                         */
+	unsigned int  probes[HT_STATS_PROBES];
+	size_t        bytes;       /*<< the memory held by the table              */
+	unsigned long hits;        /*<< the number of successful searches         */
+	unsigned long misses;      /*<< the number of unsuccessful searches       */
+} HTstats;
+
 /* --- function prototypes -------------------------------------------------- */
 
 /**
@@ -26,10 +57,13 @@ typedef struct hashtab HashTab;
  *
  * @param[in]   loadfactor
  *     the maximum load factor, which, when reached, triggers a resize of the
- *     underlying table
+ *     underlying table; values outside (0, 0.875) are taken as 0.875
  * @param[in]   hash
  *     a hash function over the domain of the keys, taking a pointer to the key
- *     and the size of the underlying table as parameters
+ *     and the size of the underlying table as parameters, such as one of the
+ *     <code>ht_hash_*</code> functions below; the table passes
+ *     <code>UINT_MAX</code> as the size to obtain a full-width hash, and
+ *     spreads it over its slots itself
  * @param[in]   cmp
  *     a function that compares two values from the domain of values, returning
  *     <code>-1</code>, <code>0</code>, or <code>1</code> if <code>val1</code>
@@ -40,6 +74,59 @@ HashTab *ht_init(float loadfactor,
 				 unsigned int (*hash)(void *key, unsigned int size),
 				 int (*cmp)(void *val1, void *val2));
 
+/**
+ * Initialises a hash table with room for the specified number of entries, so
+ * that it does not have to grow while they are inserted.
+ *
+ * @param[in]   capacity
+ *     the number of entries expected
+ * @param[in]   loadfactor
+ *     as for <code>ht_init</code>
+ * @param[in]   hash
+ *     as for <code>ht_init</code>
+ * @param[in]   cmp
+ *     as for <code>ht_init</code>
+ * @return      a pointer to the hash table container structure
+ */
+HashTab *ht_init_with_capacity(unsigned int capacity, float loadfactor,
+		unsigned int (*hash)(void *key, unsigned int size),
+		int (*cmp)(void *val1, void *val2));
+
+/**
+ * Initialises a hash table that may be searched by any number of threads while
+ * others insert into it.  Searches take no locks; inserts, and allocations
+ * with <code>ht_alloc</code>, are serialised by a lock held by the table.
+ * Deleting, clearing, visiting or printing the table, and releasing it, still
+ * require that no other thread use it at the same time.
+ *
+ * @param[in]   loadfactor
+ *     as for <code>ht_init</code>
+ * @param[in]   hash
+ *     as for <code>ht_init</code>
+ * @param[in]   cmp
+ *     as for <code>ht_init</code>
+ * @return      a pointer to the hash table container structure
+ */
+HashTab *ht_init_shared(float loadfactor,
+						unsigned int (*hash)(void *key, unsigned int size),
+						int (*cmp)(void *val1, void *val2));
+
+/**
+ * Initialises a hash table of keys of exactly <code>HT_FIXED_KEY_SIZE</code>
+ * bytes, zero-padded as for <code>ht_hash_fixed</code>, with which the table
+ * hashes them.  The table stores a copy of every key next to its slots, and
+ * compares keys as whole blocks, in one or two vector instructions where
+ * available; keys need therefore not outlive their insertion.  The keys the
+ * table hands back point into it, and are NUL-terminated only if shorter than
+ * <code>HT_FIXED_KEY_SIZE</code>; release functions passed for them are
+ * ignored.
+ *
+ * @param[in]   loadfactor
+ *     as for <code>ht_init</code>
+ * @return      a pointer to the hash table container structure
+ */
+HashTab *ht_init_fixed(float loadfactor);
+
 /**
  * Associates the specified key with the specified value in the specified hash
  * table.  Note: If the insert fails, an error code is returned.
@@ -55,6 +142,39 @@ HashTab *ht_init(float loadfactor,
  */
 int ht_insert(HashTab *ht, void *key, void *value);
 
+/**
+ * Associates each of the specified keys with the value at the same index, after
+ * making room for all of them at once.  The insertion stops at the first pair
+ * that cannot be inserted; the pairs before it remain in the table.
+ *
+ * @param[in]   ht
+ *     a pointer to the hash table in which to insert the pairs
+ * @param[in]   keys
+ *     an array of pointers to the keys
+ * @param[in]   values
+ *     an array of pointers to the values
+ * @param[in]   n
+ *     the number of pairs
+ * @return      <code>EXIT_SUCCESS</code> if all pairs were inserted, or the
+ *              error code of the first pair that was not
+ */
+int ht_insert_many(HashTab *ht, void **keys, void **values, unsigned int n);
+
+/**
+ * Makes room in the specified hash table for the specified number of entries
+ * beyond those it holds, so that it does not have to grow while they are
+ * inserted.
+ *
+ * @param[in]   ht
+ *     a pointer to the hash table
+ * @param[in]   n
+ *     the number of entries to make room for
+ * @return      <code>EXIT_SUCCESS</code> if there is room,
+ *              <code>HASH_TABLE_NO_SPACE_FOR_NODE</code> if the table could not
+ *              be grown, or <code>HASH_TABLE_FROZEN</code> if it is frozen
+ */
+int ht_reserve(HashTab *ht, unsigned int n);
+
 /**
  * Searches the specified hash table for the value associated with the
  * specified key.
@@ -72,14 +192,91 @@ int ht_insert(HashTab *ht, void *key, void *value);
 Boolean ht_search(HashTab *ht, void *key, void **value);
 
 /**
- * Frees the space associated with the specified hash table.
+ * Removes the entry with the specified key from the specified hash table.
+ *
+ * @param[in]   ht
+ *     a pointer to the hash table from which to remove the key
+ * @param[in]   key
+ *     the key of the entry to remove
+ * @param[out]  value
+ *     a pointer to the address of the variable where the value of the removed
+ *     entry, if found, will be copied, or <code>NULL</code>
+ * @return      <code>TRUE</code> if the key was found and removed, or
+ *              <code>FALSE</code> otherwise, and always if the table is frozen
+ */
+Boolean ht_delete(HashTab *ht, void *key, void **value);
+
+/**
+ * Removes all entries from the specified hash table, but keeps its slot array,
+ * so that the table can be refilled to its former size without allocating.
+ * Memory obtained from <code>ht_alloc</code> for the table is recycled.  A
+ * frozen table is thawed, and may be inserted into again.
+ *
+ * @param[in]   ht
+ *     the hash table to clear
+ * @param[in]   freekey
+ *     a pointer to a function that releases the memory resources of a key, or
+ *     <code>NULL</code> if keys need not be released
+ * @param[in]   freeval
+ *     a pointer to a function that releases the memory resources of a value,
+ *     or <code>NULL</code> if values need not be released
+ */
+void ht_clear(HashTab *ht,
+			  void (*freekey)(void *k),
+			  void (*freeval)(void *v));
+
+/**
+ * Freezes the specified hash table: its entries are moved to an array of one
+ * slot per entry, placed by a minimal perfect hash, so that every search
+ * probes a single slot.  Afterwards, inserts fail with
+ * <code>HASH_TABLE_FROZEN</code> and deletes find nothing, until the table is
+ * cleared.  Searches of a frozen table take no locks, even if it is shared.
+ * Freezing requires that no other thread use the table at the same time.
+ *
+ * @param[in]   ht
+ *     the hash table to freeze
+ * @return      <code>EXIT_SUCCESS</code> if the table was frozen or already
+ *              was, <code>HASH_TABLE_NO_SPACE_FOR_NODE</code> if there was not
+ *              enough memory, or <code>HASH_TABLE_NO_PERFECT_HASH</code> if two
+ *              keys have the same full hash; in the latter cases the table is
+ *              left as it was
+ */
+int ht_freeze(HashTab *ht);
+
+/**
+ * Steps through the entries of the specified hash table, in no particular
+ * order.  Set the cursor to zero to start, and call until it returns
+ * <code>FALSE</code>.  Apart from deleting the entry just returned, the table
+ * must not be modified until the iteration is done.
+ *
+ * @param[in]   ht
+ *     the hash table over which to iterate
+ * @param[in,out] cursor
+ *     the position of the iteration, zero before the first call
+ * @param[out]  key
+ *     a pointer to the variable where the key of the next entry will be copied
+ * @param[out]  value
+ *     a pointer to the variable where the value of the next entry will be
+ *     copied
+ * @return      <code>TRUE</code> if another entry was found, or
+ *              <code>FALSE</code> if all entries have been visited
+ */
+Boolean ht_foreach(HashTab *ht, unsigned int *cursor, void **key,
+				   void **value);
+
+/**
+ * Frees the space associated with the specified hash table, including all
+ * memory obtained from <code>ht_alloc</code> for it.  If neither a key nor a
+ * value release function is given, the entries are not visited at all.
  *
  * @param[in]   hashtable
  *     the hash table to free
  * @param[in]   freekey
- *     a pointer to a function that releases the memory resources of a key
+ *     a pointer to a function that releases the memory resources of a key, or
+ *     <code>NULL</code> if keys need not be released
  * @param[in]   freeval
- *     a pointer to a function that releases the memory resources of a value
+ *     a pointer to a function that releases the memory resources of a value,
+ *     or <code>NULL</code> if values need not be released
  * @return      <code>EXIT_SUCCESS</code> if the memory resources of the
  *              specified hash table were released successfully, or
  *              <code>EXIT_FAILURE</code> otherwise
@@ -88,6 +285,103 @@ Boolean ht_free(HashTab *ht,
 				void (*freekey)(void *k),
 				void (*freeval)(void *v));
 
+/**
+ * Collects statistics on the specified hash table.  The counts of rehashes and
+ * searches cover the whole lifetime of the table, and survive
+ * <code>ht_clear</code>.
+ *
+ * @param[in]   ht
+ *     the hash table to inspect
+ * @param[out]  stats
+ *     a pointer to the structure where the statistics will be stored
+ */
+void ht_stats(HashTab *ht, HTstats *stats);
+
+/**
+ * Writes the statistics of the specified hash table, in human-readable form,
+ * to the specified stream.
+ *
+ * @param[in]   ht
+ *     the hash table to inspect
+ * @param[in]   name
+ *     the name under which to report the table
+ * @param[in]   out
+ *     the stream to which to write
+ */
+void ht_print_stats(HashTab *ht, const char *name, FILE *out);
+
+/**
+ * Writes the specified statistics, in the form used by
+ * <code>ht_print_stats</code>, to the specified stream.  This also serves the
+ * tables defined with <code>TYPED_TABLE</code> in typedtable.h.
+ *
+ * @param[in]   stats
+ *     the statistics to write
+ * @param[in]   name
+ *     the name under which to report the table
+ * @param[in]   out
+ *     the stream to which to write
+ */
+void ht_report_stats(const HTstats *stats, const char *name, FILE *out);
+
+/**
+ * Allocates memory that belongs to the specified hash table, typically for its
+ * keys or values.  Allocations are carved consecutively out of large slabs, and
+ * are all released together by <code>ht_free</code>; they must not be freed
+ * individually, and so not by the release functions passed to it either.
+ *
+ * @param[in]   ht
+ *     the hash table that owns the memory
+ * @param[in]   n
+ *     the number of bytes to allocate
+ * @return      a pointer to the memory, aligned for any basic type, or
+ *              <code>NULL</code> if there is not enough memory
+ */
+void *ht_alloc(HashTab *ht, size_t n);
+
+/**
+ * Hashes a NUL-terminated string with 32-bit FNV-1a, one byte at a time.  This
+ * is the same hash the intern pool uses.  Suitable as the <code>hash</code>
+ * argument of <code>ht_init</code>.
+ *
+ * @param[in]   key
+ *     a pointer to a NUL-terminated string
+ * @param[in]   size
+ *     the size of the underlying table
+ * @return      the hash value of the string, reduced modulo the size
+ */
+unsigned int ht_hash_fnv1a(void *key, unsigned int size);
+
+/**
+ * Hashes a NUL-terminated string in the style of wyhash: eight bytes at a time,
+ * each pair of words mixed by a 64x64-bit multiplication folded to 64 bits.
+ * Faster than FNV-1a for longer keys, and no worse for short ones.  Suitable
+ * as the <code>hash</code> argument of <code>ht_init</code>.
+ *
+ * @param[in]   key
+ *     a pointer to a NUL-terminated string
+ * @param[in]   size
+ *     the size of the underlying table
+ * @return      the hash value of the string, reduced modulo the size
+ */
+unsigned int ht_hash_wy(void *key, unsigned int size);
+
+/**
+ * Hashes a key of exactly <code>HT_FIXED_KEY_SIZE</code> bytes, such as an
+ * identifier zero-padded to <code>MAX_ID_LENGTH</code>, as four whole words
+ * without looking for a terminator.  Suitable as the <code>hash</code>
+ * argument of <code>ht_init</code> for tables whose keys all point to such
+ * buffers.
+ *
+ * @param[in]   key
+ *     a pointer to at least <code>HT_FIXED_KEY_SIZE</code> readable bytes, with
+ *     all bytes after the identifier set to zero
+ * @param[in]   size
+ *     the size of the underlying table
+ * @return      the hash value of the key, reduced modulo the size
+ */
+unsigned int ht_hash_fixed(void *key, unsigned int size);
+
 /**
  * Displays the specified hash table on standard output.
  *
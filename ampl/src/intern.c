@@ -0,0 +1,203 @@
+/**
+ * @file    intern.c
+ * @brief   A global string-interning pool for the identifiers of AMPL-2020.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "intern.h"
+
+#define BLOCK_SIZE      16384
+#define INITIAL_SLOTS   256
+#define INITIAL_NAMES   256
+
+#define FNV_OFFSET      2166136261u
+#define FNV_PRIME       16777619u
+
+/** the header stored immediately before the characters of an interned string */
+typedef struct {
+	unsigned int hash;  /**< the full hash value of the string */
+	unsigned int id;    /**< the numeric ID of the string      */
+} Header;
+
+/** a block of storage for interned strings */
+typedef struct block Block;
+struct block {
+	Block  *next;       /**< the previously filled block       */
+	size_t  used;       /**< the number of bytes used          */
+	size_t  size;       /**< the number of bytes available     */
+	Header  data[];     /**< the storage, aligned for headers  */
+};
+
+#define HEADER(id) (((const Header *) (id)) - 1)
+
+/* --- global static variables ---------------------------------------------- */
+
+static Block         *blocks;        /* the block currently being filled      */
+static char         **slots;         /* open-addressed table of strings       */
+static unsigned int   nslots;        /* the number of slots (a power of two)  */
+static char         **names;         /* the interned strings, indexed by ID   */
+static unsigned int   nnames;        /* the number of interned strings        */
+static unsigned int   maxnames;      /* the capacity of the names array       */
+
+/* Scanners on different threads share the pool, so changes to the table, and
+ * reads of the names array, which may move, are serialised.  The hash and ID
+ * of a string never change once it is stored, and are read without the lock.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* --- function prototypes -------------------------------------------------- */
+
+static unsigned int hash_chars(const char *s, size_t len);
+static char *store(const char *s, size_t len, unsigned int hash);
+static void grow_slots(void);
+
+/* --- interning interface -------------------------------------------------- */
+
+char *intern_string(const char *s, size_t len)
+{
+	unsigned int hash, i;
+	char *id;
+
+	hash = hash_chars(s, len);
+	pthread_mutex_lock(&lock);
+
+	if (slots == NULL) {
+		nslots = INITIAL_SLOTS;
+		slots = emalloc(nslots * sizeof(char *));
+		memset(slots, 0, nslots * sizeof(char *));
+	}
+
+	for (i = hash & (nslots - 1); (id = slots[i]) != NULL;
+			i = (i + 1) & (nslots - 1)) {
+		if (HEADER(id)->hash == hash && strncmp(id, s, len) == 0
+				&& id[len] == '\0') {
+			pthread_mutex_unlock(&lock);
+			return id;
+		}
+	}
+
+	id = slots[i] = store(s, len, hash);
+	if (2 * nnames > nslots) {
+		grow_slots();
+	}
+
+	pthread_mutex_unlock(&lock);
+	return id;
+}
+
+unsigned int intern_hash(const char *id)
+{
+	return HEADER(id)->hash;
+}
+
+unsigned int intern_id(const char *id)
+{
+	return HEADER(id)->id;
+}
+
+char *intern_name(unsigned int n)
+{
+	char *id;
+
+	pthread_mutex_lock(&lock);
+	id = names[n];
+	pthread_mutex_unlock(&lock);
+
+	return id;
+}
+
+void release_intern_pool(void)
+{
+	Block *b, *next;
+
+	for (b = blocks; b != NULL; b = next) {
+		next = b->next;
+		free(b);
+	}
+	free(slots);
+	free(names);
+
+	blocks = NULL;
+	slots = names = NULL;
+	nslots = nnames = maxnames = 0;
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+/**
+ * Computes the 32-bit FNV-1a hash of the specified characters.
+ */
+static unsigned int hash_chars(const char *s, size_t len)
+{
+	unsigned int hash = FNV_OFFSET;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash = (hash ^ (unsigned char) s[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ * Copies the specified characters, preceded by their header, into the current
+ * block, and records the copy under the next numeric ID.
+ */
+static char *store(const char *s, size_t len, unsigned int hash)
+{
+	size_t need, size;
+	Header *h;
+	Block *b;
+	char *id;
+
+	/* in header-sized units, rounded up so that the next header is aligned */
+	need = 1 + (len + sizeof(Header)) / sizeof(Header);
+
+	if (blocks == NULL || blocks->used + need > blocks->size) {
+		size = need > BLOCK_SIZE ? need : BLOCK_SIZE;
+		b = emalloc(sizeof(Block) + size * sizeof(Header));
+		b->next = blocks;
+		b->used = 0;
+		b->size = size;
+		blocks = b;
+	}
+
+	h = blocks->data + blocks->used;
+	blocks->used += need;
+	h->hash = hash;
+	h->id = nnames;
+	id = (char *) (h + 1);
+	memcpy(id, s, len);
+	id[len] = '\0';
+
+	if (nnames == maxnames) {
+		maxnames = maxnames ? 2 * maxnames : INITIAL_NAMES;
+		names = erealloc(names, maxnames * sizeof(char *));
+	}
+	names[nnames++] = id;
+
+	return id;
+}
+
+/**
+ * Doubles the number of slots, and reinserts every interned string.
+ */
+static void grow_slots(void)
+{
+	unsigned int i, j;
+
+	free(slots);
+	nslots *= 2;
+	slots = emalloc(nslots * sizeof(char *));
+	memset(slots, 0, nslots * sizeof(char *));
+
+	for (i = 0; i < nnames; i++) {
+		for (j = HEADER(names[i])->hash & (nslots - 1); slots[j] != NULL;
+				j = (j + 1) & (nslots - 1))
+			;
+		slots[j] = names[i];
+	}
+}
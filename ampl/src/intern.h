@@ -0,0 +1,64 @@
+/**
+ * @file    intern.h
+ * @brief   A global string-interning pool for the identifiers of AMPL-2020.
+ *
+ * Every distinct identifier is stored exactly once.  Interned strings are
+ * canonical: two identifiers are equal if and only if their interned pointers
+ * are equal.  Each interned string also carries its hash value and a dense
+ * numeric ID, so that neither has to be recomputed by later compiler phases.
+ * Interned strings must not be modified or freed.  The pool may be used from
+ * several threads at once, but it must only be released when no thread uses it.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+/**
+ * Returns the canonical copy of the specified characters, adding them to the
+ * pool if they have not been interned before.
+ *
+ * @param[in]   s
+ *     the characters to intern (need not be NUL-terminated)
+ * @param[in]   len
+ *     the number of characters
+ * @return      the canonical, NUL-terminated copy of the characters
+ */
+char *intern_string(const char *s, size_t len);
+
+/**
+ * Returns the hash value of an interned string, as computed when the string
+ * was interned.
+ *
+ * @param[in]   id
+ *     an interned string
+ * @return      the full (unreduced) hash value of the string
+ */
+unsigned int intern_hash(const char *id);
+
+/**
+ * Returns the numeric ID of an interned string.  IDs are assigned densely from
+ * zero, in the order in which strings are first interned.
+ *
+ * @param[in]   id
+ *     an interned string
+ * @return      the numeric ID of the string
+ */
+unsigned int intern_id(const char *id);
+
+/**
+ * Returns the interned string with the specified numeric ID.
+ *
+ * @param[in]   n
+ *     a numeric ID previously returned by <code>intern_id</code>
+ * @return      the interned string
+ */
+char *intern_name(unsigned int n);
+
+/**
+ * Releases all interned strings; any pointers to them become invalid.
+ */
+void release_intern_pool(void);
+
+#endif /* INTERN_H */
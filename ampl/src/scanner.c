@@ -5,235 +5,737 @@
  * @date    2020-08-10
  */
 
-#include <ctype.h>
+#include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "boolean.h"
 #include "error.h"
+#include "intern.h"
 #include "scanner.h"
+#include "skipkernels.h"
 #include "token.h"
 
 /* --- type definitions and constants --------------------------------------- */
 
 typedef struct {
 	char      *word;                   /* the reserved word, i.e., the lexeme */
+	size_t     len;                    /* the length of the reserved word     */
 	TokenType  type;                   /* the associated token type           */
 } ResWord;
 
+/* The reserved words are stored in a perfect hash table, which is keyed on the
+ * length, the first two, and the last character of a word.  The hash function
+ * was chosen so that no two reserved words collide; since the table is laid out
+ * by the compiler with the same macro, a collision introduced by a new reserved
+ * word shows up as an "initialized field overwritten" warning.  Each lookup then
+ * costs one probe and at most one memcmp.
+ */
+#define RESERVED_TABLE_SIZE 64
+#define MIN_RESERVED_LEN    2
+#define MAX_RESERVED_LEN    7
+
+#define RESERVED_HASH(len, c0, c1, cl) \
+	(((c0) + ((c1) << 1) + ((cl) << 3) + (len)) & (RESERVED_TABLE_SIZE - 1))
+
+#define RESERVED(word, c0, c1, cl, type) \
+	[RESERVED_HASH(sizeof(word) - 1, c0, c1, cl)] = \
+		{ word, sizeof(word) - 1, type }
+
+/* The scanner core is driven by two tables.  The first classifies every
+ * character (offset by one, so that EOF has a class of its own) by the kind of
+ * token it can start or continue, independently of the locale.  The second is
+ * the transition table for operators: every operator character maps to the
+ * token it forms on its own and, where an '=' may follow, to the token formed
+ * by the pair.
+ */
+typedef enum {
+	CC_EOF,                            /* end of the source                   */
+	CC_ILLEGAL,                        /* cannot appear outside a string      */
+	CC_SPACE,                          /* whitespace                          */
+	CC_LETTER,                         /* letters and the underscore          */
+	CC_DIGIT,                          /* decimal digits                      */
+	CC_QUOTE,                          /* the string delimiter                */
+	CC_LBRACE,                         /* the comment opener                  */
+	CC_OPERATOR                        /* operators and punctuation           */
+} CharClass;
+
+typedef struct {
+	unsigned char single;              /* the token for the character alone   */
+	unsigned char with_eq;             /* the token if '=' follows, or EOF    */
+} OpTrans;
+
+#define EO CC_EOF
+#define IL CC_ILLEGAL
+#define SP CC_SPACE
+#define LE CC_LETTER
+#define DI CC_DIGIT
+#define QU CC_QUOTE
+#define LB CC_LBRACE
+#define OP CC_OPERATOR
+
+static const unsigned char char_class[257] = {
+	/* EOF */ EO,
+	/* 00 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, SP, SP, SP, SP, SP, IL, IL,
+	/* 10 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* 20 */ SP, IL, QU, IL, IL, OP, OP, IL, OP, OP, OP, OP, OP, OP, IL, OP,
+	/* 30 */ DI, DI, DI, DI, DI, DI, DI, DI, DI, DI, OP, OP, OP, OP, OP, IL,
+	/* 40 */ IL, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE,
+	/* 50 */ LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, OP, IL, OP, IL, LE,
+	/* 60 */ IL, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE,
+	/* 70 */ LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LE, LB, IL, IL, IL, IL,
+	/* 80 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* 90 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* a0 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* b0 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* c0 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* d0 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* e0 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL,
+	/* f0 */ IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL, IL
+};
+
+#undef EO
+#undef IL
+#undef SP
+#undef LE
+#undef DI
+#undef QU
+#undef LB
+#undef OP
+
+#define CLASS(c)      (char_class[(c) + 1])
+#define IS_WORD(c)    (CLASS(c) == CC_LETTER || CLASS(c) == CC_DIGIT)
+
+static const OpTrans op_trans[256] = {
+	['='] = { TOK_EQ,        TOK_EOF },
+	['>'] = { TOK_GT,        TOK_GE  },
+	['<'] = { TOK_LT,        TOK_LE  },
+	['/'] = { TOK_DIV,       TOK_NE  },
+	['-'] = { TOK_MINUS,     TOK_EOF },
+	['+'] = { TOK_PLUS,      TOK_EOF },
+	['%'] = { TOK_MOD,       TOK_EOF },
+	['*'] = { TOK_MUL,       TOK_EOF },
+	['('] = { TOK_LPAR,      TOK_EOF },
+	[')'] = { TOK_RPAR,      TOK_EOF },
+	['&'] = { TOK_CAT,       TOK_EOF },
+	[','] = { TOK_COMMA,     TOK_EOF },
+	[':'] = { TOK_COLON,     TOK_EOF },
+	[';'] = { TOK_SEMICOLON, TOK_EOF },
+	['['] = { TOK_LBRACK,    TOK_EOF },
+	[']'] = { TOK_RBRACK,    TOK_EOF }
+};
+
+/* Input that cannot be mapped is streamed through two fixed-size buffers: a
+ * reader thread fills one while the scanner works through the other, so that
+ * memory use does not depend on the size of the source.  The scanner only ever
+ * sees one buffer at a time, as if it were the whole source; the offset of its
+ * first byte is added to source positions.
+ */
+typedef struct {
+	FILE            *in_file;      /* the source file                     */
+	char            *data[2];      /* the two buffers                     */
+	size_t           len[2];       /* the number of bytes in each buffer  */
+	Boolean          full[2];      /* whether a buffer is ready for use   */
+	unsigned int     current;      /* the buffer the scanner works in     */
+	Boolean          eof;          /* whether the scanner saw the end     */
+	Boolean          stop;         /* whether the reader must stop        */
+	int              errnum;       /* the read error, or zero             */
+	pthread_t        reader;       /* the thread that fills the buffers   */
+	pthread_mutex_t  lock;         /* guards full, stop, and errnum       */
+	pthread_cond_t   changed;      /* signalled when a buffer changes     */
+} Stream;
+
+/** a block of storage for the string literals of a streamed source */
+typedef struct strblock StrBlock;
+struct strblock {
+	StrBlock *next;                /* the previously filled block         */
+	size_t    used;                /* the number of bytes used            */
+	size_t    size;                /* the number of bytes available       */
+	char      data[];              /* the storage                         */
+};
+
+/** the state of a scanner over one source file */
+struct scanner {
+	const char   *buf;             /* the start of the source text        */
+	const char   *ptr;             /* the next unread source byte         */
+	const char   *end;             /* one past the last source byte       */
+	unsigned int  base;            /* the source offset of buf            */
+	size_t        maplen;          /* mapped length, or 0 if streamed     */
+	Boolean       shared;          /* whether another scanner owns buf    */
+	Stream       *stream;          /* the streamed input, or NULL         */
+	StrBlock     *strings;         /* the kept string literals, or NULL   */
+	const char   *pending;         /* string text not yet kept, or NULL   */
+	size_t        kept;            /* the length of the text kept so far  */
+	int           ch;              /* the next source character           */
+	unsigned int *line_starts;     /* the offset of each line, or NULL    */
+	unsigned int  num_lines;       /* the number of lines indexed         */
+	unsigned int  max_lines;       /* the capacity of the line index      */
+	SourcePos     position;        /* the position after the last token   */
+};
+
+/** the source offset of the current character */
+#define CURRENT_OFFSET(sc) \
+	((sc)->base + (unsigned int) ((sc)->ptr - (sc)->buf) - ((sc)->ch != EOF))
+
 /* --- global static variables ---------------------------------------------- */
 
-static FILE *src_file;                 /* the source file pointer             */
-static int   ch;                       /* the next source character           */
-static int   column_number;            /* the current column number           */
-
-static ResWord reserved[] = {          /* reserved words                      */
-	{ "and",       TOK_AND       },
-	{ "array",     TOK_ARRAY     },
-	{ "as",        TOK_AS        },
-	{ "back",      TOK_BACK      },
-	{ "boolean",   TOK_BOOLEAN   },
-	{ "chillax",   TOK_CHILLAX   },
-	{ "do",        TOK_DO        },
-	{ "elif",      TOK_ELIF      },
-	{ "else",      TOK_ELSE      },
-	{ "end",       TOK_END       },
-	{ "false",     TOK_FALSE     },
-	{ "if",        TOK_IF        },
-	{ "input",     TOK_INPUT     },
-	{ "integer",   TOK_INTEGER   },
-	{ "let",       TOK_LET       },
-	{ "main",      TOK_MAIN      },
-	{ "mod",       TOK_MOD       },
-	{ "not",       TOK_NOT       },
-	{ "or",        TOK_OR        },
-	{ "output",    TOK_OUTPUT    },
-	{ "program",   TOK_PROGRAM   },
-	{ "returns",   TOK_RETURNS   },
-	{ "takes",     TOK_TAKES     },
-	{ "true",      TOK_TRUE      },
-	{ "vars",      TOK_VARS      },
-	{ "while",     TOK_WHILE     }
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+static _Thread_local Scanner *current;   /* the scanner that resolves errors */
+
+static const ResWord reserved[RESERVED_TABLE_SIZE] = {   /* reserved words   */
+	RESERVED("and",     'a', 'n', 'd', TOK_AND    ),
+	RESERVED("array",   'a', 'r', 'y', TOK_ARRAY  ),
+	RESERVED("as",      'a', 's', 's', TOK_AS     ),
+	RESERVED("back",    'b', 'a', 'k', TOK_BACK   ),
+	RESERVED("boolean", 'b', 'o', 'n', TOK_BOOLEAN),
+	RESERVED("chillax", 'c', 'h', 'x', TOK_CHILLAX),
+	RESERVED("do",      'd', 'o', 'o', TOK_DO     ),
+	RESERVED("elif",    'e', 'l', 'f', TOK_ELIF   ),
+	RESERVED("else",    'e', 'l', 'e', TOK_ELSE   ),
+	RESERVED("end",     'e', 'n', 'd', TOK_END    ),
+	RESERVED("false",   'f', 'a', 'e', TOK_FALSE  ),
+	RESERVED("if",      'i', 'f', 'f', TOK_IF     ),
+	RESERVED("input",   'i', 'n', 't', TOK_INPUT  ),
+	RESERVED("integer", 'i', 'n', 'r', TOK_INTEGER),
+	RESERVED("let",     'l', 'e', 't', TOK_LET    ),
+	RESERVED("main",    'm', 'a', 'n', TOK_MAIN   ),
+	RESERVED("mod",     'm', 'o', 'd', TOK_MOD    ),
+	RESERVED("not",     'n', 'o', 't', TOK_NOT    ),
+	RESERVED("or",      'o', 'r', 'r', TOK_OR     ),
+	RESERVED("output",  'o', 'u', 't', TOK_OUTPUT ),
+	RESERVED("program", 'p', 'r', 'm', TOK_PROGRAM),
+	RESERVED("returns", 'r', 'e', 's', TOK_RETURNS),
+	RESERVED("takes",   't', 'a', 's', TOK_TAKES  ),
+	RESERVED("true",    't', 'r', 'e', TOK_TRUE   ),
+	RESERVED("vars",    'v', 'a', 's', TOK_VARS   ),
+	RESERVED("while",   'w', 'h', 'e', TOK_WHILE  )
 };
 
-#define NUM_RESERVED_WORDS     (sizeof(reserved) / sizeof(ResWord))
-#define MAX_INITIAL_STRING_LEN (1024)
+#define STREAM_CHUNK_SIZE  (64 * 1024)
+#define STRING_BLOCK_SIZE  4096
+#define INITIAL_LINES      1024
 
 /* --- function prototypes -------------------------------------------------- */
 
-static void next_char(void);
-static void process_number(Token *token);
-static void process_string(Token *token);
-static void process_word(Token *token);
-static void skip_comment(void);
+static void select_kernels(void);
+static void next_char(Scanner *sc);
+static void jump_to(Scanner *sc, const char *p);
+static void mark_position(Scanner *sc);
+static void resolve_offset(void *context, unsigned int offset, int *line,
+		int *col);
+static void map_source(Scanner *sc, FILE *in_file);
+static void open_stream(Scanner *sc, FILE *in_file);
+static void close_stream(Scanner *sc);
+static void *read_chunks(void *arg);
+static int next_chunk(Scanner *sc);
+static void keep_text(Scanner *sc, const char *from, const char *to);
+static void start_line_index(Scanner *sc);
+static void index_lines(Scanner *sc);
+static void process_number(Scanner *sc, Token *token);
+static void process_string(Scanner *sc, Token *token);
+static void process_word(Scanner *sc, Token *token);
+static void skip_comment(Scanner *sc, unsigned int outer);
 
 /* --- scanner interface ---------------------------------------------------- */
 
-void init_scanner(FILE *in_file)
+Scanner *init_scanner(FILE *in_file)
 {
-	src_file = in_file;
-	position.line = 1;
-	position.col = column_number = 0;
-	next_char();
+	Scanner *sc;
+
+	sc = emalloc(sizeof(Scanner));
+	sc->buf = sc->end = NULL;
+	sc->base = 0;
+	sc->shared = FALSE;
+	sc->stream = NULL;
+	sc->strings = NULL;
+	sc->pending = NULL;
+	sc->kept = 0;
+	pthread_once(&kernels_once, select_kernels);
+
+	/* positions are resolved to lines and columns only when reported, but the
+	 * lines of streamed input must be indexed before its buffer is reused */
+	sc->line_starts = NULL;
+	sc->num_lines = sc->max_lines = 0;
+
+	map_source(sc, in_file);
+	if (sc->maplen == 0) {
+		open_stream(sc, in_file);
+		start_line_index(sc);
+	}
+	sc->ptr = sc->buf;
+
+	/* errors on this thread are in this source until another scanner is used */
+	current = sc;
+	setposresolver(resolve_offset, sc);
+
+	next_char(sc);
+	mark_position(sc);
+
+	return sc;
 }
 
-void get_token(Token *token)
+void get_token(Scanner *sc, Token *token)
 {
-	/* remove whitespace */
-	/* TODO: Skip all whitespace characters before the start of the token. */
-	while (isspace(ch) || ch == 10) {
-		next_char();
+	const OpTrans *op;
+	unsigned int outer;
+
+	/* positions reported by this thread are in the source of this scanner */
+	if (current != sc) {
+		current = sc;
+		setposresolver(resolve_offset, sc);
 	}
 
-	/* remember token start */
-	position.col = column_number;
+	/* remove whitespace, which may continue in the next buffer */
+	while (CLASS(sc->ch) == CC_SPACE) {
+		jump_to(sc, sk_space(sc->ptr - 1, sc->end));
+	}
 
 	/* get the next token */
-	if (ch != EOF) {
-
-		if (isalpha(ch) || ch == '_') {
-			/* process a word */
-			process_word(token);
-
-		} else if (isdigit(ch)) {
-			/* process a number */
-			process_number(token);
-
-		} else switch (ch) {
-
-			/* process a string */
-			case '"':
-				position.col = column_number;
-				next_char();
-				process_string(token);
-				next_char();
-				break;
-
-			/* TODO: Trigger comment skipping, and process all the remaining
-			 * tokens.
-			 */
-			 case '{':
-			 	next_char();
-				position.col--;
-				skip_comment();
-				get_token(token);
-				break;
-			/* relational operators */
-			case '=':
-				token->type = TOK_EQ;
-				next_char();
-				break;
-			case '>':
-				token->type = TOK_GT;
-				next_char();
-				if (ch == '=') {
-					token->type = TOK_GE;
-					next_char();
-				}
-				break;
-			case '<':
-				token->type = TOK_LT;
-				next_char();
-				if (ch == '=') {
-					token->type = TOK_LE;
-					next_char();
-				}
-				break;
-			case '/':
-				token->type = TOK_DIV;
-				next_char();
-				if (ch == '=') {
-					token->type = TOK_NE;
-					next_char();
-					break;
-				}
-				break;
-			/* additive operators */
-			case '-':
-				token->type = TOK_MINUS;
-				next_char();
-				break;
-			case '+':
-				token->type = TOK_PLUS;
-				next_char();
-				break;
-
-			/* multiplicative operators */
-			case '%':
-				token->type = TOK_MOD;
-				next_char();
-				break;
-			case '*':
-				token->type = TOK_MUL;
-				next_char();
-				break;
-
-			/* other non-alphabetic operators */
-			case '(':
-				token->type = TOK_LPAR;
-				next_char();
-				break;
-			case ')':
-				token->type = TOK_RPAR;
-				next_char();
-				break;
-			case '&':
-				token->type = TOK_CAT;
-				next_char();
-				break;
-			case ',':
-				token->type = TOK_COMMA;
-				next_char();
-				break;
-			case ':':
-				token->type = TOK_COLON;
-				next_char();
-				break;
-			case ';':
-				token->type = TOK_SEMICOLON;
-				next_char();
-				break;
-			case '[':
-				token->type = TOK_LBRACK;
-				next_char();
-				break;
-			case ']':
-				token->type = TOK_RBRACK;
-				next_char();
-				break;
-			default:
-				leprintf("illegal character '%c' (ASCII #%d)", ch, (int)ch);
+	switch (CLASS(sc->ch)) {
+
+		/* process a word */
+		case CC_LETTER:
+			process_word(sc, token);
+			break;
+
+		/* process a number */
+		case CC_DIGIT:
+			process_number(sc, token);
+			break;
+
+		/* process a string */
+		case CC_QUOTE:
+			next_char(sc);
+			process_string(sc, token);
+			next_char(sc);
+			break;
+
+		/* skip a comment, and process the token following it */
+		case CC_LBRACE:
+			outer = CURRENT_OFFSET(sc);
+			next_char(sc);
+			skip_comment(sc, outer);
+			get_token(sc, token);
+			break;
+
+		/* operators: take the '=' transition if there is one */
+		case CC_OPERATOR:
+			op = &op_trans[sc->ch];
+			next_char(sc);
+			if (sc->ch == '=' && op->with_eq != TOK_EOF) {
+				token->type = op->with_eq;
+				next_char(sc);
+			} else {
+				token->type = op->single;
+			}
+			break;
+
+		case CC_EOF:
+			token->type = TOK_EOF;
+			break;
+
+		default:
+			mark_position(sc);
+			leprintf("illegal character '%c' (ASCII #%d)", sc->ch,
+					(int)sc->ch);
+	}
+
+	/* the position is that of the character just after the token */
+	mark_position(sc);
+}
+
+const SourcePos *get_scanner_position(Scanner *sc)
+{
+	return &sc->position;
+}
+
+size_t get_mapped_length(Scanner *sc)
+{
+	return sc->maplen;
+}
+
+Scanner *fork_scanner(Scanner *sc, unsigned int offset)
+{
+	Scanner *fork;
+	const char *p;
+
+	fork = emalloc(sizeof(Scanner));
+	*fork = *sc;
+	fork->maplen = 0;
+	fork->shared = TRUE;
+	fork->stream = NULL;
+	fork->strings = NULL;
+	fork->pending = NULL;
+	fork->line_starts = NULL;
+	fork->num_lines = fork->max_lines = 0;
+
+	/* start at the first line that starts at or after the offset */
+	p = sc->buf + offset;
+	if (offset > 0 && p[-1] != '\n') {
+		p = memchr(p, '\n', (size_t) (sc->end - p));
+		p = (p != NULL) ? p + 1 : sc->end;
+	}
+	fork->ptr = p;
+	next_char(fork);
+	fork->position.offset = CURRENT_OFFSET(fork);
+	fork->position.line = 0;
+	fork->position.col = 0;
+
+	return fork;
+}
+
+void seek_scanner(Scanner *sc, unsigned int offset)
+{
+	sc->ptr = sc->buf + offset;
+	next_char(sc);
+}
+
+TokenType lookup_reserved(const char *word, size_t len)
+{
+	const ResWord *rw;
+
+	if (len < MIN_RESERVED_LEN || len > MAX_RESERVED_LEN) {
+		return TOK_ID;
+	}
+
+	rw = &reserved[RESERVED_HASH(len, (unsigned char) word[0],
+			(unsigned char) word[1], (unsigned char) word[len-1])];
+	if (rw->len == len && memcmp(rw->word, word, len) == 0) {
+		return rw->type;
+	}
+
+	return TOK_ID;
+}
+
+void release_scanner(Scanner *sc)
+{
+	StrBlock *b, *next;
+
+	/* a forked scanner leaves its source to the scanner it was forked from */
+	if (sc->maplen > 0) {
+		munmap((void *) sc->buf, sc->maplen);
+	} else if (!sc->shared) {
+		close_stream(sc);
+	}
+	for (b = sc->strings; b != NULL; b = next) {
+		next = b->next;
+		free(b);
+	}
+	free(sc->line_starts);
+	releaseposresolver(sc);
+	if (current == sc) {
+		current = NULL;
+	}
+	free(sc);
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+/**
+ * Selects the fastest skipping kernels, once for all scanners.
+ */
+static void select_kernels(void)
+{
+	sk_select(NULL);
+}
+
+/**
+ * Maps a regular source file into memory.  On success, the source text is
+ * available between the buf and end fields of the scanner, and maplen is set;
+ * on failure (pipes, terminals, empty files, or mmap errors), maplen is left at
+ * zero.
+ */
+static void map_source(Scanner *sc, FILE *in_file)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	sc->maplen = 0;
+	fd = fileno(in_file);
+	if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+			|| st.st_size <= 0) {
+		return;
+	}
+
+	p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		return;
+	}
+	madvise(p, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+	sc->buf = p;
+	sc->end = sc->buf + st.st_size;
+	sc->maplen = (size_t) st.st_size;
+}
+
+/**
+ * Sets up the double buffers for input that cannot be mapped, and starts the
+ * reader thread that fills them.
+ */
+static void open_stream(Scanner *sc, FILE *in_file)
+{
+	Stream *st;
+	int i;
+
+	st = emalloc(sizeof(Stream));
+	st->in_file = in_file;
+	for (i = 0; i < 2; i++) {
+		st->data[i] = emalloc(STREAM_CHUNK_SIZE);
+		st->len[i] = 0;
+		st->full[i] = FALSE;
+	}
+	st->current = 0;
+	st->eof = st->stop = FALSE;
+	st->errnum = 0;
+	pthread_mutex_init(&st->lock, NULL);
+	pthread_cond_init(&st->changed, NULL);
+
+	if ((errno = pthread_create(&st->reader, NULL, read_chunks, st)) != 0) {
+		eprintf("could not start reading source file:");
+	}
+	sc->stream = st;
+}
+
+/**
+ * Stops the reader thread, and frees the buffers.  If the scanner stopped
+ * before the end of the source, this waits for the read in progress.
+ */
+static void close_stream(Scanner *sc)
+{
+	Stream *st = sc->stream;
+
+	pthread_mutex_lock(&st->lock);
+	st->stop = TRUE;
+	pthread_cond_signal(&st->changed);
+	pthread_mutex_unlock(&st->lock);
+	pthread_join(st->reader, NULL);
+
+	pthread_mutex_destroy(&st->lock);
+	pthread_cond_destroy(&st->changed);
+	free(st->data[0]);
+	free(st->data[1]);
+	free(st);
+}
+
+/**
+ * Fills the buffers of a stream in turn, each as soon as the scanner hands it
+ * back, until the end of the source.  An empty buffer marks the end.
+ */
+static void *read_chunks(void *arg)
+{
+	Stream *st = arg;
+	unsigned int i;
+	size_t n;
+
+	i = 0;
+	do {
+		pthread_mutex_lock(&st->lock);
+		while (st->full[i] && !st->stop) {
+			pthread_cond_wait(&st->changed, &st->lock);
+		}
+		if (st->stop) {
+			pthread_mutex_unlock(&st->lock);
+			break;
+		}
+		pthread_mutex_unlock(&st->lock);
+
+		n = fread(st->data[i], 1, STREAM_CHUNK_SIZE, st->in_file);
+
+		pthread_mutex_lock(&st->lock);
+		if (n == 0 && ferror(st->in_file)) {
+			st->errnum = (errno != 0) ? errno : EIO;
 		}
+		st->len[i] = n;
+		st->full[i] = TRUE;
+		pthread_cond_signal(&st->changed);
+		pthread_mutex_unlock(&st->lock);
+
+		i ^= 1;
+	} while (n > 0);
+
+	return NULL;
+}
+
+/**
+ * Moves a streaming scanner on to the next buffer, once the reader has filled
+ * it, and hands the buffer just finished back to the reader.  Any string text
+ * in the finished buffer is kept first.  This is kept out of line, so that
+ * next_char stays small enough to be inlined.
+ *
+ * @return      the first character of the next buffer, or EOF
+ */
+__attribute__((noinline))
+static int next_chunk(Scanner *sc)
+{
+	Stream *st = sc->stream;
+	unsigned int i;
+
+	if (st == NULL || st->eof) {
+		return EOF;
+	}
+	if (sc->pending != NULL) {
+		keep_text(sc, sc->pending, sc->end);
+	}
+
+	pthread_mutex_lock(&st->lock);
+	if (sc->buf != NULL) {
+		sc->base += (unsigned int) (sc->end - sc->buf);
+		st->full[st->current] = FALSE;
+		st->current ^= 1;
+		pthread_cond_signal(&st->changed);
+	}
+	i = st->current;
+	while (!st->full[i]) {
+		pthread_cond_wait(&st->changed, &st->lock);
+	}
+	pthread_mutex_unlock(&st->lock);
+
+	if (st->errnum != 0) {
+		errno = st->errnum;
+		eprintf("could not read source file:");
+	}
+
+	sc->buf = sc->ptr = st->data[i];
+	sc->end = sc->buf + st->len[i];
+	if (sc->pending != NULL) {
+		sc->pending = sc->buf;
+	}
+	if (sc->buf == sc->end) {
+		st->eof = TRUE;
+		return EOF;
+	}
+	index_lines(sc);
+
+	return (unsigned char) *sc->ptr++;
+}
+
+/**
+ * Appends source text to the string literal being kept.  The text of a
+ * literal is kept contiguous, so it is moved to a new block if it outgrows the
+ * current one.
+ */
+static void keep_text(Scanner *sc, const char *from, const char *to)
+{
+	StrBlock *b = sc->strings, *nb;
+	size_t n = (size_t) (to - from), size;
+
+	if (b == NULL || b->used + sc->kept + n > b->size) {
+		for (size = STRING_BLOCK_SIZE; size < sc->kept + n; size *= 2)
+			;
+		nb = emalloc(sizeof(StrBlock) + size);
+		nb->next = b;
+		nb->used = 0;
+		nb->size = size;
+		if (b != NULL) {
+			memcpy(nb->data, b->data + b->used, sc->kept);
+		}
+		sc->strings = b = nb;
+	}
+	memcpy(b->data + b->used + sc->kept, from, n);
+	sc->kept += n;
+}
+
+/**
+ * Starts an index with only the first line in it.
+ */
+static void start_line_index(Scanner *sc)
+{
+	sc->max_lines = INITIAL_LINES;
+	sc->line_starts = emalloc(sc->max_lines * sizeof(unsigned int));
+	sc->line_starts[0] = 0;
+	sc->num_lines = 1;
+}
+
+/**
+ * Adds the lines that start in the text between buf and end to the index.
+ */
+static void index_lines(Scanner *sc)
+{
+	unsigned int i, n;
+
+	n = sk_lines(sc->buf, sc->end, NULL);
+	if (sc->num_lines + n > sc->max_lines) {
+		while (sc->num_lines + n > sc->max_lines) {
+			sc->max_lines *= 2;
+		}
+		sc->line_starts = erealloc(sc->line_starts,
+				sc->max_lines * sizeof(unsigned int));
+	}
+	sk_lines(sc->buf, sc->end, sc->line_starts + sc->num_lines);
+	for (i = sc->num_lines; i < sc->num_lines + n; i++) {
+		sc->line_starts[i] += sc->base;
+	}
+	sc->num_lines += n;
+}
+
+void next_char(Scanner *sc)
+{
+	sc->ch = (sc->ptr < sc->end) ? (unsigned char) *sc->ptr++ : next_chunk(sc);
+}
+
+/**
+ * Makes the character at the specified position the current character.  A
+ * position at the end of the buffer continues with the next buffer, if any.
+ */
+void jump_to(Scanner *sc, const char *p)
+{
+	if (p < sc->end) {
+		sc->ch = (unsigned char) *p;
+		sc->ptr = p + 1;
 	} else {
-		token->type = TOK_EOF;
+		sc->ptr = sc->end;
+		next_char(sc);
 	}
 }
 
-/* --- utility functions ---------------------------------------------------- */
+/**
+ * Sets the position of the scanner, and the error position of the calling
+ * thread, to the current character.
+ */
+void mark_position(Scanner *sc)
+{
+	sc->position.offset = CURRENT_OFFSET(sc);
+	sc->position.line = 0;
+	sc->position.col = 0;
+	position = sc->position;
+}
 
-void next_char(void)
+/**
+ * Finds the line and column number of a source offset.  Lines are numbered
+ * from one.  Columns on the first line are numbered from one, and on the other
+ * lines from zero.  The line index of a mapped source is built on first use.
+ */
+void resolve_offset(void *context, unsigned int offset, int *line, int *col)
 {
-	static char last_read = '\0';
+	Scanner *sc = context;
+	unsigned int low, high, mid;
 
-	/* TODO:
-	 * - Get the next character from the source file.
-	 * - Increment the line number if the previous character is EOL.
-	 * - Reset the global column number when necessary.
-	 * - DO NOT USE feof!!!
-	 */
-	 last_read = ch;
-	 ch = getc(src_file);
-	 if (last_read == '\n') {
-	 	position.line++;
-		position.col = 0;
-		column_number = 0;
-	 } else {
-		position.col++;
-		column_number++;
-	 }
+	if (sc->line_starts == NULL) {
+		start_line_index(sc);
+		index_lines(sc);
+	}
+
+	/* find the last line that starts at or before the offset */
+	low = 0;
+	high = sc->num_lines - 1;
+	while (low < high) {
+		mid = (low + high + 1) / 2;
+		if (sc->line_starts[mid] <= offset) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	*line = low + 1;
+	*col = offset - sc->line_starts[low] + (low == 0);
 }
 
-void process_number(Token *token)
+void process_number(Scanner *sc, Token *token)
 {
 	/* TODO:
 	 * - Build numbers up to the specificied maximum magnitude.
@@ -242,172 +744,155 @@ void process_number(Token *token)
 	 * - "Remember" the correct column number globally.
 	 */
 
-	token->value = (ch - '0');
+	token->value = (sc->ch - '0');
 	token->type = TOK_NUM;
-	next_char();
-	while (isdigit(ch)) {
-		if (token->value > (INT_MAX - (ch - '0'))/10) {
+	next_char(sc);
+	while (CLASS(sc->ch) == CC_DIGIT) {
+		if (token->value > (INT_MAX - (sc->ch - '0'))/10) {
 			// Throw an error here
+			mark_position(sc);
 			leprintf("number too large");
 			return;
 		}
-		token->value = (token->value)*10 + (ch - '0');
-		next_char();
+		token->value = (token->value)*10 + (sc->ch - '0');
+		next_char(sc);
 	}
-	if (isalpha(ch) || ch == '_') {
-		leprintf("illegal character '%c' (ASCII #%d)", ch, (int)ch);
+	if (CLASS(sc->ch) == CC_LETTER) {
+		mark_position(sc);
+		leprintf("illegal character '%c' (ASCII #%d)", sc->ch, (int)sc->ch);
 	}
 	return;
 }
 
-void process_string(Token *token)
+void process_string(Scanner *sc, Token *token)
 {
-	size_t i, nstring = MAX_INITIAL_STRING_LEN;
+	size_t i;
+	int prev;
+	Boolean escapes;
+	const char *text;
+	SourcePos start_pos;
+
+	/* the literal is left in the source text, and escape codes are kept as
+	 * written; they are only checked here */
+	/* an unclosed string is reported one line up and one column left */
+	mark_position(sc);
+	start_pos = sc->position;
+	start_pos.line--;
+	start_pos.col--;
+
 	i = 0;
-	/* TODO:
-	 * - Allocate heap space of the maximum initial string length.
-	 * - If a string is about to overflow while scanning it, double the amount
-	 *   of space available.
-	 * - ONLY printable ASCII characters are allowed; see man 3 isalpha.
-	 * - Check the legality of escape codes.
-	 * - Set the appropriate token type.
-	 */
-	char *cp;
-	int start_col = position.col - 1;
-	int start_line = position.line - 1;
-	cp = malloc(nstring);
-	while (ch != '"' && ch != EOF) {
-		if (ch == 9) {
-			leprintf("non-printable character (ASCII #%d)", (int)ch);
-		}
-		if (i + 1 == nstring) {
-			nstring = 2*nstring;
-			cp = realloc(cp, nstring);
+	escapes = FALSE;
+	text = sc->ptr - (sc->ch != EOF);
+	if (sc->stream != NULL) {
+		sc->pending = text;
+	}
+	while (sc->ch != '"' && sc->ch != EOF) {
+		if (sc->ch == '\t') {
+			mark_position(sc);
+			leprintf("non-printable character (ASCII #%d)", (int)sc->ch);
 		}
-		*(cp + i) = ch;
-		next_char();
-		if (i >= 1) {
-			if (*(cp + i) == '\\') {
-				if (ch != 'n' && ch != 't' && ch != '"' && ch != '\\') {
-					position.col--;
-					leprintf("illegal escape code '\\%c' in string", ch);
-				} else switch (ch) {
-					case 'n':
-						*(cp + i + 1) = 'n';
-						break;
-					case 't':
-						*(cp + i + 1) = 't';
-						break;
-					case '"':
-						*(cp + i + 1) = '"';
-						break;
-					default:
-						*(cp + i + 1) = '\\';
-						break;
-				}
-				i++;
-				next_char();
+		prev = sc->ch;
+		next_char(sc);
+		if (i >= 1 && prev == '\\') {
+			if (sc->ch != 'n' && sc->ch != 't' && sc->ch != '"'
+					&& sc->ch != '\\') {
+				mark_position(sc);
+				position.col--;
+				leprintf("illegal escape code '\\%c' in string", sc->ch);
 			}
+			escapes = TRUE;
+			i++;
+			next_char(sc);
 		}
 		i++;
 	}
-	if (ch == EOF) {
-		position.col = start_col;
-		position.line = start_line;
+	if (sc->ch == EOF) {
+		position = start_pos;
 		leprintf("string not closed");
 	}
-	*(cp + i) = '\0';
-	token->string = malloc(nstring);
 	token->type = TOK_STR;
-	strcpy(token->string, cp);
+
+	/* the buffers of a streamed source are reused, so its literals are kept
+	 * elsewhere, including text from buffers already handed back */
+	if (sc->stream != NULL) {
+		keep_text(sc, sc->pending, sc->ptr - 1);
+		text = sc->strings->data + sc->strings->used;
+		token->string.len = (unsigned int) sc->kept;
+		sc->strings->used += sc->kept;
+		sc->kept = 0;
+		sc->pending = NULL;
+	} else {
+		token->string.len = (unsigned int) (sc->ptr - 1 - text);
+	}
+
+	token->string.text = text;
+	token->string.escapes = escapes;
 }
 
-void process_word(Token *token)
+void process_word(Scanner *sc, Token *token)
 {
-	char lexeme[MAX_ID_LENGTH+1];
-	int i, cmp, low, mid, high;
+	int i;
 
 	i = 0;
 
-	position.col = column_number;
-
 	/* check that the id length is less than the maximum */
-	/* TODO */
-
-	/* do a binary search through the array of reserved words */
-	/* TODO */
-
-	/* if id was not recognised as a reserved word, it is an identifier */
-	token->type = TOK_ID;
-	strcpy(token->lexeme, lexeme);
-	
-	while (isdigit(ch) || isalpha(ch) || ch == '_') {
+	while (IS_WORD(sc->ch)) {
 		if (i < MAX_ID_LENGTH) {
-			if (ch == '_' && isdigit(token->lexeme[i-1])) {
+			if (sc->ch == '_' && i > 0 && CLASS((unsigned char) token->lexeme[i-1]) == CC_DIGIT) {
+				mark_position(sc);
 				leprintf("Illegal character. '_' not allowed after digit in identifier.\n");
 			}
-			token->lexeme[i] = ch;
+			token->lexeme[i] = sc->ch;
 			i++;
-			next_char();
+			next_char(sc);
 		} else {
+			mark_position(sc);
 			leprintf("identifier too long.\n");
 		}
 	}
 	
-	if (ch == '^') {
-		leprintf("illegal character '%c' in identifier", ch);
+	if (sc->ch == '^') {
+		mark_position(sc);
+		leprintf("illegal character '%c' in identifier", sc->ch);
 	}
 		
 	token->lexeme[i] = '\0';	
-	low = 0;
-	high = NUM_RESERVED_WORDS;
-	mid = (high + low)/2;
-	cmp = strcmp(token->lexeme, reserved[mid].word);
-	while (high - low > 1) {
-		if (cmp < 0) {
-			high = mid;
-			mid = (high + low)/2;
-			cmp = strcmp(token->lexeme, reserved[mid].word);
-		} else if (cmp > 0) {
-			low = mid;
-			mid = (high + low)/2;
-			cmp = strcmp(token->lexeme, reserved[mid].word);
-		}
-		if (cmp == 0) {
-			token->type = reserved[mid].type;
-			return;
-		}
+
+	/* if id was not recognised as a reserved word, it is an identifier */
+	token->type = lookup_reserved(token->lexeme, i);
+	if (token->type == TOK_ID) {
+		token->id = intern_string(token->lexeme, i);
 	}
-	return;
 }
 
-void skip_comment(void)
+void skip_comment(Scanner *sc, unsigned int outer)
 {
-	SourcePos start_pos;
+	unsigned int start;
+	int outer_line, start_line, col;
 
 	/* TODO:
 	 * - Skip nested comments RECURSIVELY, which is to say, counting strategies
 	 *   are not allowed.
 	 * - Terminate with an error if comments are not nested properly.
 	 */
-	start_pos.col = position.col;
-	start_pos.line = position.line;
-
-	while (ch != '}') {
-		if (ch == '{') {
-			next_char();
-			skip_comment();
-		} else if (ch == EOF) {
-			position.col = start_pos.col;
-			position.line = start_pos.line;
+	start = CURRENT_OFFSET(sc);
+
+	while (sc->ch != '}') {
+		if (sc->ch == '{') {
+			next_char(sc);
+			skip_comment(sc, outer);
+		} else if (sc->ch == EOF) {
+			/* report the column after the opening brace, less one if no
+			 * newline follows the outermost opening brace */
+			resolve_offset(sc, outer, &outer_line, &col);
+			resolve_offset(sc, start, &start_line, &col);
+			position.offset = start;
+			position.line = 0;
+			position.col = (start_line > outer_line) ? 0 : -1;
 			leprintf("comment not closed");
 		} else {
-			next_char();
+			jump_to(sc, sk_brace(sc->ptr - 1, sc->end));
 		}
 	}
-	next_char();
-	return;
-
-	/* force line number of error reporting */
-	position = start_pos;
+	next_char(sc);
 }
@@ -10,22 +10,104 @@
 #define SCANNER_H
 
 #include <stdio.h>
+#include "error.h"
 #include "token.h"
 
 /**
- * Initialises the scanner.
+ * the context of a scanner, which holds all of its state, so that several
+ * source files can be scanned at once, on the same or on different threads
+ */
+typedef struct scanner Scanner;
+
+/**
+ * Initialises a scanner.  Regular files are mapped into memory.  Other input,
+ * such as pipes and the standard input, is streamed through two fixed-size
+ * buffers, which a background thread refills; memory use then does not grow
+ * with the source, except for the string literals and a four-byte index entry
+ * per line, which the scanner keeps until it is released.
  *
  * @param[in]   in_file
  *     the (already open) source file
+ * @return      a pointer to the scanner context
+ */
+Scanner *init_scanner(FILE *in_file);
+
+/**
+ * Looks up a word in the table of reserved words.
+ *
+ * @param[in]   word
+ *     the characters of the word (need not be NUL-terminated)
+ * @param[in]   len
+ *     the number of characters in the word
+ * @return      the token type of the reserved word, or <code>TOK_ID</code> if
+ *              the word is not reserved
  */
-void init_scanner(FILE *in_file);
+TokenType lookup_reserved(const char *word, size_t len);
 
 /**
- * Gets the next token from the input (source) file.
+ * Releases the scanner and the source text it holds.  The source file itself
+ * is not closed.
  *
+ * @param[in]   sc
+ *     the scanner to release
+ */
+void release_scanner(Scanner *sc);
+
+/**
+ * Gets the next token from the input (source) file.  The position after the
+ * token is also made the error position of the calling thread, so that the
+ * errors reported there are resolved against the source of this scanner.
+ *
+ * @param[in]   sc
+ *     the scanner
  * @param[out]  token
  *     contains the token just scanned
  */
-void get_token(Token *token);
+void get_token(Scanner *sc, Token *token);
+
+/**
+ * Returns the position of the scanner, which is that of the character just
+ * after the last token scanned.
+ *
+ * @param[in]   sc
+ *     the scanner
+ * @return      the position of the scanner
+ */
+const SourcePos *get_scanner_position(Scanner *sc);
+
+/**
+ * Returns the length of the source of the specified scanner if it is mapped
+ * into memory.  Only mapped sources can be scanned from arbitrary offsets.
+ *
+ * @param[in]   sc
+ *     the scanner
+ * @return      the length of the mapped source, or 0 if it is streamed
+ */
+size_t get_mapped_length(Scanner *sc);
+
+/**
+ * Creates a scanner over the mapped source of the specified scanner, which
+ * starts at the first line that starts at or after the specified offset, as if
+ * that were outside any comment or string.  The new scanner may be used on
+ * another thread, and must be released before the scanner it was forked from.
+ *
+ * @param[in]   sc
+ *     the scanner with a mapped source
+ * @param[in]   offset
+ *     the source offset from which to look for a line start
+ * @return      a pointer to the new scanner
+ */
+Scanner *fork_scanner(Scanner *sc, unsigned int offset);
+
+/**
+ * Moves a scanner with a mapped source to the specified offset, which must be
+ * a position at which the scanner has left off after a token.
+ *
+ * @param[in]   sc
+ *     the scanner with a mapped source
+ * @param[in]   offset
+ *     the source offset of the next character to scan
+ */
+void seek_scanner(Scanner *sc, unsigned int offset);
 
 #endif /* SCANNER_H */
@@ -0,0 +1,312 @@
+/**
+ * @file    skipkernels.c
+ * @brief   Vectorised kernels that skip whitespace and comment text, and find
+ *          line starts, for the scanner of AMPL-2020.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "boolean.h"
+#include "skipkernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/** a set of kernels */
+typedef struct {
+	const char *name;
+	const char *(*space)(const char *p, const char *end);
+	const char *(*brace)(const char *p, const char *end);
+	unsigned int (*lines)(const char *p, const char *end,
+			unsigned int *starts);
+	Boolean (*supported)(void);
+} Kernels;
+
+#define IS_SPACE(c)   ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+/* --- function prototypes -------------------------------------------------- */
+
+static const char *space_scalar(const char *p, const char *end);
+static const char *brace_scalar(const char *p, const char *end);
+static unsigned int lines_scalar(const char *p, const char *end,
+		unsigned int *starts);
+static unsigned int lines_from(const char *p, const char *q, const char *end,
+		unsigned int *starts);
+static Boolean always(void);
+
+#ifdef HAVE_X86_KERNELS
+static unsigned int add_lines(unsigned int mask, unsigned int base,
+		unsigned int *starts);
+static const char *space_sse2(const char *p, const char *end);
+static const char *brace_sse2(const char *p, const char *end);
+static unsigned int lines_sse2(const char *p, const char *end,
+		unsigned int *starts);
+static Boolean has_sse2(void);
+static const char *space_avx2(const char *p, const char *end);
+static const char *brace_avx2(const char *p, const char *end);
+static unsigned int lines_avx2(const char *p, const char *end,
+		unsigned int *starts);
+static Boolean has_avx2(void);
+#endif
+
+/* --- global static variables ---------------------------------------------- */
+
+/** the available kernels, fastest first */
+static const Kernels kernels[] = {
+#ifdef HAVE_X86_KERNELS
+	{ "avx2",   space_avx2,   brace_avx2,   lines_avx2,   has_avx2 },
+	{ "sse2",   space_sse2,   brace_sse2,   lines_sse2,   has_sse2 },
+#endif
+	{ "scalar", space_scalar, brace_scalar, lines_scalar, always   }
+};
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(Kernels))
+
+static const Kernels *active = &kernels[NUM_KERNELS - 1];
+
+/* --- kernel interface ----------------------------------------------------- */
+
+Boolean sk_select(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < NUM_KERNELS; i++) {
+		if ((name == NULL || strcmp(name, kernels[i].name) == 0)
+				&& kernels[i].supported()) {
+			active = &kernels[i];
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+const char *sk_name(void)
+{
+	return active->name;
+}
+
+const char *sk_space(const char *p, const char *end)
+{
+	return active->space(p, end);
+}
+
+const char *sk_brace(const char *p, const char *end)
+{
+	return active->brace(p, end);
+}
+
+unsigned int sk_lines(const char *p, const char *end, unsigned int *starts)
+{
+	return active->lines(p, end, starts);
+}
+
+/* --- scalar kernels ------------------------------------------------------- */
+
+static const char *space_scalar(const char *p, const char *end)
+{
+	while (p < end && IS_SPACE(*p)) {
+		p++;
+	}
+
+	return p;
+}
+
+static const char *brace_scalar(const char *p, const char *end)
+{
+	while (p < end && *p != '{' && *p != '}') {
+		p++;
+	}
+
+	return p;
+}
+
+static unsigned int lines_scalar(const char *p, const char *end,
+		unsigned int *starts)
+{
+	return lines_from(p, p, end, starts);
+}
+
+/**
+ * Finds the line starts in the bytes from q up to end, and records their
+ * offsets relative to p.
+ */
+static unsigned int lines_from(const char *p, const char *q, const char *end,
+		unsigned int *starts)
+{
+	unsigned int n = 0;
+
+	for (; (q = memchr(q, '\n', end - q)) != NULL; n++) {
+		q++;
+		if (starts) {
+			starts[n] = q - p;
+		}
+	}
+
+	return n;
+}
+
+static Boolean always(void)
+{
+	return TRUE;
+}
+
+/* --- x86 kernels ---------------------------------------------------------- */
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * The vector kernels compute a bit mask per block, in which bit i stands for
+ * byte i of the block.  The tail of the input is left to the next narrower
+ * kernels.
+ */
+
+__attribute__((target("sse2")))
+static const char *space_sse2(const char *p, const char *end)
+{
+	const __m128i sp = _mm_set1_epi8(' ');
+	const __m128i lo = _mm_set1_epi8('\t' - 1), hi = _mm_set1_epi8('\r' + 1);
+	__m128i v, ws;
+	unsigned int stop;
+
+	for (; end - p >= 16; p += 16) {
+		v = _mm_loadu_si128((const __m128i *) p);
+		ws = _mm_or_si128(_mm_cmpeq_epi8(v, sp),
+				_mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi)));
+		stop = ~_mm_movemask_epi8(ws) & 0xffff;
+		if (stop) {
+			return p + __builtin_ctz(stop);
+		}
+	}
+
+	return space_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char *brace_sse2(const char *p, const char *end)
+{
+	const __m128i lb = _mm_set1_epi8('{'), rb = _mm_set1_epi8('}');
+	__m128i v;
+	unsigned int stop;
+
+	for (; end - p >= 16; p += 16) {
+		v = _mm_loadu_si128((const __m128i *) p);
+		stop = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, lb),
+					_mm_cmpeq_epi8(v, rb)));
+		if (stop) {
+			return p + __builtin_ctz(stop);
+		}
+	}
+
+	return brace_scalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static unsigned int lines_sse2(const char *p, const char *end,
+		unsigned int *starts)
+{
+	const __m128i lf = _mm_set1_epi8('\n');
+	const char *q;
+	unsigned int n, mask;
+
+	for (n = 0, q = p; end - q >= 16; q += 16) {
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+					_mm_loadu_si128((const __m128i *) q), lf));
+		n += add_lines(mask, q - p, starts ? starts + n : NULL);
+	}
+
+	return n + lines_from(p, q, end, starts ? starts + n : NULL);
+}
+
+static Boolean has_sse2(void)
+{
+	return __builtin_cpu_supports("sse2") ? TRUE : FALSE;
+}
+
+__attribute__((target("avx2")))
+static const char *space_avx2(const char *p, const char *end)
+{
+	const __m256i sp = _mm256_set1_epi8(' ');
+	const __m256i lo = _mm256_set1_epi8('\t' - 1);
+	const __m256i hi = _mm256_set1_epi8('\r' + 1);
+	__m256i v, ws;
+	unsigned int stop;
+
+	for (; end - p >= 32; p += 32) {
+		v = _mm256_loadu_si256((const __m256i *) p);
+		ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+				_mm256_and_si256(_mm256_cmpgt_epi8(v, lo),
+					_mm256_cmpgt_epi8(hi, v)));
+		stop = ~(unsigned int) _mm256_movemask_epi8(ws);
+		if (stop) {
+			return p + __builtin_ctz(stop);
+		}
+	}
+
+	return space_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *brace_avx2(const char *p, const char *end)
+{
+	const __m256i lb = _mm256_set1_epi8('{'), rb = _mm256_set1_epi8('}');
+	__m256i v;
+	unsigned int stop;
+
+	for (; end - p >= 32; p += 32) {
+		v = _mm256_loadu_si256((const __m256i *) p);
+		stop = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, lb),
+					_mm256_cmpeq_epi8(v, rb)));
+		if (stop) {
+			return p + __builtin_ctz(stop);
+		}
+	}
+
+	return brace_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static unsigned int lines_avx2(const char *p, const char *end,
+		unsigned int *starts)
+{
+	const __m256i lf = _mm256_set1_epi8('\n');
+	const char *q;
+	unsigned int n, mask;
+
+	for (n = 0, q = p; end - q >= 32; q += 32) {
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+					_mm256_loadu_si256((const __m256i *) q), lf));
+		n += add_lines(mask, q - p, starts ? starts + n : NULL);
+	}
+
+	return n + lines_from(p, q, end, starts ? starts + n : NULL);
+}
+
+static Boolean has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2") ? TRUE : FALSE;
+}
+
+/**
+ * Records the line starts after the newlines in the specified mask, for a
+ * block at the specified offset, and returns the number of newlines.
+ */
+static unsigned int add_lines(unsigned int mask, unsigned int base,
+		unsigned int *starts)
+{
+	unsigned int n;
+
+	if (starts == NULL) {
+		return __builtin_popcount(mask);
+	}
+
+	for (n = 0; mask; mask &= mask - 1) {
+		starts[n++] = base + __builtin_ctz(mask) + 1;
+	}
+
+	return n;
+}
+
+#endif /* HAVE_X86_KERNELS */
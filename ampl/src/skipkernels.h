@@ -0,0 +1,74 @@
+/**
+ * @file    skipkernels.h
+ * @brief   Vectorised kernels that skip whitespace and comment text, and find
+ *          line starts, for the scanner of AMPL-2020.
+ *
+ * The skipping kernels scan forward from a pointer, and return a pointer to
+ * the first byte that the scanner must look at itself.  On x86 processors,
+ * SSE2 and AVX2 versions that test 16 or 32 bytes at a time are selected at
+ * run time; elsewhere, a scalar version is used.
+ */
+
+#ifndef SKIPKERNELS_H
+#define SKIPKERNELS_H
+
+#include "boolean.h"
+
+/**
+ * Selects the kernels to use.  If no name is specified, the fastest kernels
+ * supported by the processor are selected.
+ *
+ * @param[in]   name
+ *     <code>"avx2"</code>, <code>"sse2"</code>, <code>"scalar"</code>, or
+ *     <code>NULL</code>
+ * @return      <code>TRUE</code> if the kernels were selected, or
+ *              <code>FALSE</code> if they are unknown or not supported by the
+ *              processor
+ */
+Boolean sk_select(const char *name);
+
+/**
+ * Returns the name of the kernels in use.
+ *
+ * @return      the name of the selected kernels
+ */
+const char *sk_name(void);
+
+/**
+ * Skips whitespace, that is, the characters HT, LF, VT, FF, CR, and space.
+ *
+ * @param[in]   p
+ *     the first byte to examine
+ * @param[in]   end
+ *     one past the last byte to examine
+ * @return      the first byte that is not whitespace, or <code>end</code>
+ */
+const char *sk_space(const char *p, const char *end);
+
+/**
+ * Skips comment text, up to the next opening or closing brace.
+ *
+ * @param[in]   p
+ *     the first byte to examine
+ * @param[in]   end
+ *     one past the last byte to examine
+ * @return      the first brace, or <code>end</code>
+ */
+const char *sk_brace(const char *p, const char *end);
+
+/**
+ * Finds the start of every line after the first, that is, the byte after
+ * every newline.
+ *
+ * @param[in]   p
+ *     the first byte to examine
+ * @param[in]   end
+ *     one past the last byte to examine
+ * @param[out]  starts
+ *     if not <code>NULL</code>, receives the offsets of the line starts,
+ *     relative to <code>p</code>, in ascending order
+ * @return      the number of newlines found
+ */
+unsigned int sk_lines(const char *p, const char *end, unsigned int *starts);
+
+#endif /* SKIPKERNELS_H */
@@ -12,39 +12,58 @@
 #include "boolean.h"
 #include "error.h"
 #include "hashtable.h"
+#include "intern.h"
 #include "symboltable.h"
 #include "token.h"
+#include "typedtable.h"
 #include "errmsg.h"
 
+#define PRINT_BUFFER_SIZE 1024
+
+/* --- type definitions ----------------------------------------------------- */
+
+/* Identifiers are interned, so their hash values were computed by the pool,
+ * and equal identifiers are the same pointer.
+ */
+
+#define ID_EQ(a, b) ((a) == (b))
+
+/* the table of the locals of a subroutine, with hashing and comparison inlined
+ * on the path of every lookup of a local */
+TYPED_TABLE(IdTab, idtab, char *, IDprop *, intern_hash, ID_EQ)
+
 /* --- global static variables ---------------------------------------------- */
 
-static HashTab *table, *saved_table;
+static HashTab *table;         /* the global symbol table                     */
+static IdTab locals;           /* the locals, reused by every subroutine      */
 /* TODO: Nothing here, but note that the next variable keeps a running coount of
  * the number of variables in the current symbol table.  It will be necessary
  * during code generation, to compute the size of the local variable array of a
  * method frame in the Java virtual machine.
  */
 static unsigned int curr_offset;
+static FILE *stats_out;        /* where to report table statistics, if at all */
+static char *subroutine_id;    /* the subroutine being compiled, if any       */
 
 /* --- function prototypes -------------------------------------------------- */
 
 static void valstr(void *key, void *p, char *str);
-static unsigned int shift_hash(void *key, unsigned int size);
-static int key_strcmp(void *val1, void *val2);
-static void freekey(void *k);
-static void freeval(void *v);
+static unsigned int id_hash(void *key, unsigned int size);
+static int id_cmp(void *val1, void *val2);
 void release_symbol_table(void);
-int ht_find_id(HashTab *ht, void *key, void **value);
 void abort_compile(Error err, ...);
 
 /* --- symbol table interface ----------------------------------------------- */
 
 void init_symbol_table(void)
 {
-	saved_table = NULL;
-	if ((table = ht_init(0.75f, shift_hash, key_strcmp)) == NULL) {
+	/* the globals are shared, so that find_name may consult them from several
+	 * threads while functions are still being inserted */
+	if ((table = ht_init_shared(0.75f, id_hash, id_cmp)) == NULL) {
 		eprintf("Symbol table could not be initialised");
 	}
+	idtab_init(&locals, 0.75f);
+	subroutine_id = NULL;
 	curr_offset = 0;
 }
 
@@ -60,12 +79,11 @@ Boolean open_subroutine(char *id, IDprop *prop)
 	 curr_offset = 0;
 	 Boolean insert_success = insert_name(id, prop);
 	 if (insert_success) {
-		if ((saved_table = ht_init(0.75f, shift_hash, key_strcmp)) == NULL) {
-			eprintf("Symbol table could not be initialised");
-		}
-	 	saved_table = table;
-		if ((table = ht_init(0.75f, shift_hash, key_strcmp)) == NULL) {
-			eprintf("Symbol table could not be initialised");
+		subroutine_id = id;
+		/* main is the last global, so the globals are fixed from here on; if
+		 * they cannot be frozen, they are simply searched as before */
+		if (!strcmp(id, "main")) {
+			ht_freeze(table);
 		}
 	 }
 	 return insert_success;
@@ -74,11 +92,16 @@ Boolean open_subroutine(char *id, IDprop *prop)
 void close_subroutine(void)
 {
 	/* TODO: Release the subroutine table, and reactivate the global table. */
-	table = NULL;
-	if ((table = ht_init(0.75f, shift_hash, key_strcmp)) == NULL) {
-		eprintf("Symbol table could not be initialised");
+	char name[MAX_ID_LENGTH + 16];
+	HTstats st;
+
+	if (stats_out) {
+		sprintf(name, "locals of %s", subroutine_id);
+		idtab_stats(&locals, &st);
+		ht_report_stats(&st, name, stats_out);
 	}
-	table = saved_table;
+	idtab_clear(&locals);
+	subroutine_id = NULL;
 }
 
 Boolean insert_name(char *id, IDprop *prop)
@@ -106,7 +129,8 @@ Boolean insert_name(char *id, IDprop *prop)
 		}
 	}
 
-	insert_exit_code = ht_insert(table, id, prop);
+	insert_exit_code = subroutine_id ? idtab_insert(&locals, id, prop)
+		: ht_insert(table, id, prop);
 	if (insert_exit_code == EXIT_SUCCESS) {
 		return TRUE;
 	} else {
@@ -118,6 +142,16 @@ Boolean insert_name(char *id, IDprop *prop)
 
 }
 
+void reserve_names(unsigned int n)
+{
+	/* if no room can be made, the inserts report the failure themselves */
+	if (subroutine_id) {
+		idtab_reserve(&locals, n);
+	} else {
+		ht_reserve(table, n);
+	}
+}
+
 Boolean find_name(char *id, IDprop **prop)
 {
 	Boolean found;
@@ -125,9 +159,13 @@ Boolean find_name(char *id, IDprop **prop)
 	/* TODO: Nothing... unless you need something here to prevent local
 	 * variables from hiding function names.
 	 */
-	found = ht_search(table, id, (void **) prop);
-	if (!found && saved_table != NULL) {
-		found = ht_search(saved_table, id, (void **) prop);
+	if (!subroutine_id) {
+		return ht_search(table, id, (void **) prop);
+	}
+
+	found = idtab_search(&locals, id, prop);
+	if (!found) {
+		found = ht_search(table, id, (void **) prop);
 		if (found && !IS_CALLABLE_TYPE((*prop)->type)) {
 			found = FALSE;
 		}
@@ -144,12 +182,37 @@ int get_variables_width(void)
 void release_symbol_table(void)
 {
 	/* TODO: Free the underlying structures of the symbol table. */
-	ht_free(table, &freekey, &freeval);
+	ht_free(table, NULL, NULL);
+	idtab_free(&locals);
 }
 
 void print_symbol_table(void)
 {
-	ht_print(table, valstr);
+	unsigned int cursor = 0;
+	char *id, str[PRINT_BUFFER_SIZE];
+	IDprop *prop;
+
+	if (!subroutine_id) {
+		ht_print(table, valstr);
+		return;
+	}
+
+	while (idtab_foreach(&locals, &cursor, &id, &prop)) {
+		valstr(id, prop, str);
+		printf("local --> %s\n", str);
+	}
+}
+
+void set_symbol_table_stats(FILE *out)
+{
+	stats_out = out;
+}
+
+void print_symbol_table_stats(void)
+{
+	if (stats_out) {
+		ht_print_stats(table, "globals", stats_out);
+	}
 }
 
 /* --- utility functions ---------------------------------------------------- */
@@ -174,32 +237,14 @@ static void valstr(void *key, void *p, char *str)
  * use some kind of cyclic bit shift hash.
  */
 
-static unsigned int shift_hash(void *key, unsigned int size)
-{
-	unsigned int hash = 0;
-	char *cp = (char *)key;
-	const int bit_shift = 2;
-
-	for (int i = 0; cp[i] != '\0'; i++) {
-		hash = (hash+(int)cp[i]) << bit_shift;
-	}
-
-	return hash % size;
-}
-
-static void freekey(void *k)
-{
-	k = NULL;
-}
-
-static void freeval(void *v)
+static unsigned int id_hash(void *key, unsigned int size)
 {
-	v = NULL;
+	return intern_hash((char *) key) % size;
 }
 
-static int key_strcmp(void *val1, void *val2)
+static int id_cmp(void *val1, void *val2)
 {
-	return strcmp((const char *)val1, (const char *)val2);
+	return val1 != val2;
 }
 
 void reset_offset(void) {
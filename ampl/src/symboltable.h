@@ -8,10 +8,15 @@
 #ifndef SYMBOLTABLE_H
 #define SYMBOLTABLE_H
 
+#include <stdio.h>
 #include "boolean.h"
 #include "token.h"
 #include "valtypes.h"
 
+/* All identifiers passed to the symbol table must have been interned with
+ * intern_string: they are hashed and compared by their canonical pointers.
+ */
+
 typedef struct {
 	ValType       type;     /*<< variable type or function return type     */
 	unsigned int  offset;   /*<< local variable offset for code generation */
@@ -28,7 +33,9 @@ void init_symbol_table(void);
  * Opens a new function or procedure (subroutine) context by (1) inserting the
  * subroutine name and properties into the global symbol table, (2) preserving
  * the global symbol table for later re-use, and (3) initialising a new local
- * symbol table for the subroutine as current symbol table.
+ * symbol table for the subroutine as current symbol table.  Opening
+ * <code>main</code>, which must come last, closes the global scope: the global
+ * symbol table is then frozen, so that every search of it probes one slot.
  *
  * @param[in]   id
  *     the identifier of the new function or procedure
@@ -48,9 +55,9 @@ void close_subroutine(void);
 
 /**
  * Inserts the specified identifier with the specified properties into the
- * current symbol table.  This function "steals" the <code>id</code> and
- * <code>prop</code> pointers, and assumes responsibility for their
- * deallocation.
+ * current symbol table.  This function "steals" the <code>prop</code> pointer,
+ * and assumes responsibility for its deallocation; the interned
+ * <code>id</code> belongs to the intern pool.
  *
  * @param[in]   id
  *     the identifier to insert
@@ -62,6 +69,16 @@ void close_subroutine(void);
  */
 Boolean insert_name(char *id, IDprop *prop);
 
+/**
+ * Makes room in the current symbol table for the specified number of
+ * identifiers, which are about to be inserted.  This is only a hint: it is not
+ * an error to insert more or fewer.
+ *
+ * @param[in]   n
+ *     the number of identifiers about to be inserted
+ */
+void reserve_names(unsigned int n);
+
 /**
  * Retrieves the properties associated with the specified identifier from the
  * current symbol table.
@@ -91,4 +108,21 @@ void release_symbol_table(void);
  */
 void print_symbol_table(void);
 
+/**
+ * Enables hash table statistics reports on the specified stream.  From then on,
+ * the local table of each subroutine is reported when the subroutine is
+ * closed, and the global table by <code>print_symbol_table_stats</code>.
+ *
+ * @param[in]   out
+ *     the stream to which to write the reports, or <code>NULL</code> to
+ *     disable them
+ */
+void set_symbol_table_stats(FILE *out);
+
+/**
+ * Reports the hash table statistics of the global symbol table, if reports
+ * have been enabled.
+ */
+void print_symbol_table_stats(void);
+
 #endif /* SYMBOLTABLE_H */
@@ -26,7 +26,6 @@ typedef struct {
 
 /* --- function prototypes -------------------------------------------------- */
 
-unsigned int hash(void *key, unsigned int size);
 int scmp(void *v1, void *v2);
 void val2str(void *key, void *value, char *buffer);
 
@@ -39,20 +38,21 @@ int main()
 	Name *np;
 	HashTab *ht;
 
-	ht = ht_init(0.75f, hash, scmp);
+	ht = ht_init(0.75f, ht_hash_fnv1a, scmp);
 	printf("Type \"search <Enter>\" to stop inserting and start searching.\n");
 	printf(">> ");
 	scanf("%s", buffer);
 	while (strcmp(buffer, "search") != 0) {
-		np = emalloc(sizeof(Name));
-		np->id = strdup(buffer);
+		if (!(np = ht_alloc(ht, sizeof(Name)))
+				|| !(np->id = ht_alloc(ht, strlen(buffer) + 1))) {
+			eprintf("Out of memory");
+		}
+		strcpy(np->id, buffer);
 		np->num = i++;
 		if ((ret = ht_insert(ht, np->id, np)) == EXIT_SUCCESS) {
 			printf("Insert %s with %d\n", np->id, np->num);
 		} else {
 			printf("Not inserted...! (%i)\n", ret);
-			free(np->id);
-			free(np);
 		}
 		printf(">> ");
 		scanf("%s", buffer);
@@ -74,27 +74,13 @@ int main()
 	}
 	printf("\n");
 
-	ht_free(ht, free, free);
+	ht_free(ht, NULL, NULL);
 
 	return EXIT_SUCCESS;
 }
 
 /* --- hash helper functions ------------------------------------------------ */
 
-unsigned int hash(void *key, unsigned int size)
-{
-	char *keystr = (char *) key;
-	unsigned int i, hash, length;
-
-	hash = 0;
-	length = strlen(keystr);
-	for (i = 0; i < length; i++) {
-		hash += keystr[i];
-	}
-
-	return (hash % size);
-}
-
 int scmp(void *v1, void *v2)
 {
 	return strcmp((char *) v1, (char *) v2);
@@ -19,11 +19,12 @@ void print_token(Token *token);
 int main(int argc, char *argv[])
 {
 	Token token;
+	Scanner *sc;
 	FILE *in_file;
 
 	/* set up program name and token */
 	setprogname(argv[0]);
-	token.string = NULL;
+	token.string.text = NULL;
 
 	/* check command-line argument and open file */
 	if (argc != 2) {
@@ -37,15 +38,19 @@ int main(int argc, char *argv[])
 	}
 
 	/* initialise scanner */
-	init_scanner(in_file);
+	sc = init_scanner(in_file);
 
 	/* iterate over tokens in the input file */
-	get_token(&token);
+	get_token(sc, &token);
 	while (token.type != TOK_EOF) {
 		print_token(&token);
-		get_token(&token);
+		get_token(sc, &token);
 	}
 
+	/* release the source */
+	release_scanner(sc);
+	fclose(in_file);
+
 	/* free names */
 	freeprogname();
 	freesrcname();
@@ -66,8 +71,8 @@ void print_token(Token *token)
 		printf("Number: %d\n", token->value);
 		break;
 	case TOK_STR:
-		printf("String: \"%s\"\n", token->string);
-		free(token->string);
+		printf("String: \"%.*s\"\n", (int) token->string.len,
+				token->string.text);
 		break;
 	default:
 		printf("%s\n", get_token_string(token->type));
@@ -13,6 +13,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "boolean.h"
+#include "intern.h"
 #include "symboltable.h"
 
 #define BUFFER_SIZE 1024
@@ -55,7 +56,7 @@ int main()
 				continue;
 			}
 
-			id = strdup(buffer);
+			id = intern_string(buffer, strlen(buffer));
 			propts = malloc(sizeof(IDprop));
 			propts->type = TYPE_CALLABLE | TYPE_INTEGER;
 			propts->nparams = 0;
@@ -65,7 +66,6 @@ int main()
 				main_is_active = FALSE;
 			} else {
 				printf("Subroutine already exists ... not added.\n");
-				free(id);
 				free(propts);
 			}
 
@@ -86,7 +86,7 @@ int main()
 		} else if (strcmp(buffer, "id_type") == 0) {
 
 			scanf("%s", buffer);
-			id = strdup(buffer);
+			id = intern_string(buffer, strlen(buffer));
 			void *kvp = malloc(sizeof(void *));
 			void **vvp = malloc(sizeof(IDprop));
 			kvp = &id;
@@ -95,7 +95,7 @@ int main()
 		} else if (strcmp(buffer, "insert") == 0) {
 
 			scanf("%s", buffer);
-			id = strdup(buffer);
+			id = intern_string(buffer, strlen(buffer));
 			propts = malloc(sizeof(IDprop));
 			propts->type = TYPE_INTEGER;
 			propts->nparams = 0;
@@ -103,14 +103,14 @@ int main()
 
 			if (!insert_name(id, propts)) {
 				printf("Identifier already exists ... not added.\n");
-				free(id);
 				free(propts);
 			}
 
 		} else if (strcmp(buffer, "find") == 0) {
 
 			scanf("%s", buffer);
-			if (find_name(buffer, &propts)) {
+			id = intern_string(buffer, strlen(buffer));
+			if (find_name(id, &propts)) {
 				printf("\"%s\" at offset %i.\n", buffer,
 						propts->offset);
 			} else {
@@ -132,6 +132,7 @@ int main()
 
 	printf("Goodbye!\n");
 	release_symbol_table();
+	release_intern_pool();
 
 	return EXIT_SUCCESS;
 }
@@ -9,6 +9,8 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include "boolean.h"
+
 /** the maximum length of an identifier */
 #define MAX_ID_LENGTH 32
 
@@ -81,13 +83,22 @@ typedef enum {
 
 } TokenType;
 
+/** a string literal, as a slice of the source text */
+typedef struct {
+	const char   *text;     /**< the characters after the opening quote     */
+	unsigned int  len;      /**< the number of characters up to the closing
+	                             quote                                      */
+	Boolean       escapes;  /**< whether the characters hold escape codes   */
+} StrSlice;
+
 /** the token data type */
 typedef struct {
 	TokenType  type;                        /**< the type of the token        */
+	char      *id;                          /**< interned identifier name     */
 	union {
 		int    value;                      /**< numeric value (for integers) */
 		char   lexeme[MAX_ID_LENGTH+1];    /**< lexeme for identifiers       */
-		char  *string;                     /**< string (for write)           */
+		StrSlice string;                   /**< string (for write)           */
 	};
 } Token;
 
@@ -0,0 +1,425 @@
+/**
+ * @file    tokenstream.c
+ * @brief   A compact, pre-scanned token stream for AMPL-2020.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "boolean.h"
+#include "error.h"
+#include "intern.h"
+#include "scanner.h"
+#include "token.h"
+#include "tokenstream.h"
+
+#define INITIAL_TOKENS     1024
+#define INITIAL_LEXEMES    4096
+#define INITIAL_STRINGS    64
+#define NUM_TOKEN_TYPES    (TOK_RBRACK + 1)
+#define NO_LEXEME          ((unsigned int) -1)
+
+#define PARALLEL_MIN_SIZE  (1024 * 1024)
+#define MAX_WORKERS        16
+
+/** a token stream container */
+struct tokenstream {
+	/** the type of each token                                            */
+	unsigned char *types;
+	/** the value of each numeric literal, the intern ID of each identifier,
+	 * or an index into the lexemes or the strings                        */
+	unsigned int *payloads;
+	/** the source offset just past each token                            */
+	unsigned int *offsets;
+	/** the number of tokens, and the capacity of the token arrays        */
+	unsigned int ntokens, maxtokens;
+
+	/** NUL-terminated lexemes of reserved words                          */
+	char *lexemes;
+	/** the used size and capacity of the lexeme array                    */
+	size_t lexlen, maxlex;
+	/** the lexeme index of each reserved word, stored only once          */
+	unsigned int keywords[NUM_TOKEN_TYPES];
+
+	/** the string literals                                               */
+	StrSlice *strings;
+	/** the number of string literals, and the capacity of the array      */
+	unsigned int nstrings, maxstrings;
+};
+
+/* Large mapped sources are split into one chunk per worker thread, at line
+ * starts.  Each worker scans its chunk speculatively, as if the chunk started
+ * outside any comment or string, into a token stream of its own; a lexical
+ * error only ends the speculation.  The chunks are then merged in order: a
+ * speculative token is used if it was scanned from the very offset at which
+ * the tokens before it left off, since the scanner is then in the same state
+ * as a sequential scan would be.  Where no such token exists, for example when
+ * a chunk starts inside a comment, tokens are scanned sequentially until the
+ * scan lines up with a speculative token again.
+ */
+typedef struct {
+	Scanner      *sc;                /* the forked scanner for the chunk     */
+	unsigned int  start;             /* the offset of the chunk              */
+	unsigned int  limit;             /* the offset at which to stop scanning */
+	TokenStream  *ts;                /* the tokens scanned                   */
+	pthread_t     worker;            /* the thread that scans the chunk      */
+} Chunk;
+
+/* --- function prototypes -------------------------------------------------- */
+
+static void scan_parallel(TokenStream *ts, Scanner *sc, unsigned int n);
+static void *scan_chunk(void *arg);
+static void merge_chunks(TokenStream *ts, Scanner *sc, Chunk *chunks,
+		unsigned int n);
+static unsigned int scanned_from(Chunk *chunk, unsigned int index);
+static void append_token(TokenStream *ts, Token *token, unsigned int offset);
+static TokenType copy_token(TokenStream *ts, TokenStream *from,
+		unsigned int index);
+static int is_reserved(TokenType type);
+static unsigned int keyword_lexeme(TokenStream *ts, TokenType type,
+		const char *lexeme);
+static unsigned int add_lexeme(TokenStream *ts, const char *lexeme);
+static unsigned int add_string(TokenStream *ts, StrSlice *string);
+static void add_token(TokenStream *ts, TokenType type, unsigned int payload,
+		unsigned int offset);
+
+/* --- token stream interface ----------------------------------------------- */
+
+TokenStream *ts_init(void)
+{
+	TokenStream *ts;
+	unsigned int i;
+
+	ts = emalloc(sizeof(TokenStream));
+
+	ts->ntokens = 0;
+	ts->maxtokens = INITIAL_TOKENS;
+	ts->types = emalloc(ts->maxtokens * sizeof(unsigned char));
+	ts->payloads = emalloc(ts->maxtokens * sizeof(unsigned int));
+	ts->offsets = emalloc(ts->maxtokens * sizeof(unsigned int));
+
+	ts->lexlen = 0;
+	ts->maxlex = INITIAL_LEXEMES;
+	ts->lexemes = emalloc(ts->maxlex);
+	for (i = 0; i < NUM_TOKEN_TYPES; i++) {
+		ts->keywords[i] = NO_LEXEME;
+	}
+
+	ts->nstrings = 0;
+	ts->maxstrings = INITIAL_STRINGS;
+	ts->strings = emalloc(ts->maxstrings * sizeof(StrSlice));
+
+	return ts;
+}
+
+void ts_scan(TokenStream *ts, Scanner *sc)
+{
+	Token token;
+	long ncpus;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (get_mapped_length(sc) >= PARALLEL_MIN_SIZE && ncpus > 1) {
+		scan_parallel(ts, sc, (ncpus < MAX_WORKERS) ? ncpus : MAX_WORKERS);
+		return;
+	}
+
+	do {
+		get_token(sc, &token);
+		append_token(ts, &token, get_scanner_position(sc)->offset);
+	} while (token.type != TOK_EOF);
+}
+
+unsigned int ts_length(TokenStream *ts)
+{
+	return ts->ntokens;
+}
+
+TokenType ts_type(TokenStream *ts, unsigned int index)
+{
+	if (index >= ts->ntokens) {
+		index = ts->ntokens - 1;
+	}
+	return ts->types[index];
+}
+
+void ts_get_token(TokenStream *ts, unsigned int index, Token *token)
+{
+
+	if (index >= ts->ntokens) {
+		index = ts->ntokens - 1;
+	}
+
+	/* fill in the same fields that the scanner fills in */
+	token->type = ts->types[index];
+	switch (token->type) {
+		case TOK_ID:
+			token->id = intern_name(ts->payloads[index]);
+			strcpy(token->lexeme, token->id);
+			break;
+		case TOK_NUM:
+			token->value = ts->payloads[index];
+			break;
+		case TOK_STR:
+			token->string = ts->strings[ts->payloads[index]];
+			break;
+		default:
+			if (is_reserved(token->type)) {
+				strcpy(token->lexeme, ts->lexemes + ts->payloads[index]);
+			}
+			break;
+	}
+
+	position.offset = ts->offsets[index];
+	position.line = 0;
+	position.col = 0;
+}
+
+void ts_free(TokenStream *ts)
+{
+	free(ts->types);
+	free(ts->payloads);
+	free(ts->offsets);
+	free(ts->lexemes);
+	free(ts->strings);
+	free(ts);
+}
+
+/* --- parallel scanning ---------------------------------------------------- */
+
+static void scan_parallel(TokenStream *ts, Scanner *sc, unsigned int n)
+{
+	Chunk *chunks;
+	size_t len;
+	unsigned int i;
+
+	len = get_mapped_length(sc);
+	chunks = emalloc(n * sizeof(Chunk));
+	for (i = 0; i < n; i++) {
+		chunks[i].sc = fork_scanner(sc, (unsigned int) (len * i / n));
+		chunks[i].start = get_scanner_position(chunks[i].sc)->offset;
+		chunks[i].ts = ts_init();
+	}
+	for (i = 0; i < n; i++) {
+		chunks[i].limit = (i + 1 < n) ? chunks[i+1].start : UINT_MAX;
+		errno = pthread_create(&chunks[i].worker, NULL, scan_chunk,
+				&chunks[i]);
+		if (errno != 0) {
+			eprintf("could not start scanning thread:");
+		}
+	}
+	for (i = 0; i < n; i++) {
+		pthread_join(chunks[i].worker, NULL);
+	}
+
+	merge_chunks(ts, sc, chunks, n);
+
+	for (i = 0; i < n; i++) {
+		release_scanner(chunks[i].sc);
+		ts_free(chunks[i].ts);
+	}
+	free(chunks);
+}
+
+/**
+ * Scans the tokens of one chunk speculatively, until the scan passes the start
+ * of the next chunk, reaches the end of the source, or runs into an error.
+ */
+static void *scan_chunk(void *arg)
+{
+	Chunk *chunk = arg;
+	jmp_buf trap;
+	Token token;
+
+	if (setjmp(trap) == 0) {
+		seterrortrap(&trap);
+		while (get_scanner_position(chunk->sc)->offset < chunk->limit) {
+			get_token(chunk->sc, &token);
+			append_token(chunk->ts, &token,
+					get_scanner_position(chunk->sc)->offset);
+			if (token.type == TOK_EOF) {
+				break;
+			}
+		}
+	}
+	seterrortrap(NULL);
+
+	return NULL;
+}
+
+/**
+ * Appends the tokens of the whole source to the specified stream, taking them
+ * from the chunks where their speculation holds, and otherwise scanning them
+ * with the specified scanner.
+ */
+static void merge_chunks(TokenStream *ts, Scanner *sc, Chunk *chunks,
+		unsigned int n)
+{
+	unsigned int c, k, at;
+	Boolean synced;
+	TokenType type;
+	Token token;
+
+	/* the next token is scanned from the offset "at"; the scanner is only
+	 * moved there when it is needed */
+	c = k = at = 0;
+	synced = TRUE;
+	do {
+		/* skip speculative tokens scanned from before that offset */
+		while (c < n) {
+			if (k >= chunks[c].ts->ntokens) {
+				c++;
+				k = 0;
+			} else if (scanned_from(&chunks[c], k) < at) {
+				k++;
+			} else {
+				break;
+			}
+		}
+
+		if (c < n && scanned_from(&chunks[c], k) == at) {
+			type = copy_token(ts, chunks[c].ts, k);
+			at = chunks[c].ts->offsets[k++];
+			synced = FALSE;
+		} else {
+			if (!synced) {
+				seek_scanner(sc, at);
+				synced = TRUE;
+			}
+			get_token(sc, &token);
+			at = get_scanner_position(sc)->offset;
+			append_token(ts, &token, at);
+			type = token.type;
+		}
+	} while (type != TOK_EOF);
+}
+
+/**
+ * Returns the offset from which the token at the specified index of a chunk
+ * was scanned: the start of the chunk, or where the previous token ended.
+ */
+static unsigned int scanned_from(Chunk *chunk, unsigned int index)
+{
+	return (index == 0) ? chunk->start : chunk->ts->offsets[index-1];
+}
+
+/* --- utility functions ---------------------------------------------------- */
+
+/**
+ * Appends a token just scanned to the specified stream.
+ */
+static void append_token(TokenStream *ts, Token *token, unsigned int offset)
+{
+	unsigned int payload;
+
+	switch (token->type) {
+		case TOK_ID:
+			payload = intern_id(token->id);
+			break;
+		case TOK_NUM:
+			payload = token->value;
+			break;
+		case TOK_STR:
+			payload = add_string(ts, &token->string);
+			break;
+		default:
+			payload = 0;
+			/* the parser measures the lexeme of reserved words, too */
+			if (is_reserved(token->type)) {
+				payload = keyword_lexeme(ts, token->type, token->lexeme);
+			}
+			break;
+	}
+
+	add_token(ts, token->type, payload, offset);
+}
+
+/**
+ * Appends the token at the specified index of another stream to the specified
+ * stream, and returns its type.
+ */
+static TokenType copy_token(TokenStream *ts, TokenStream *from,
+		unsigned int index)
+{
+	TokenType type;
+	unsigned int payload;
+
+	type = from->types[index];
+	payload = from->payloads[index];
+	if (type == TOK_STR) {
+		payload = add_string(ts, &from->strings[payload]);
+	} else if (is_reserved(type)) {
+		payload = keyword_lexeme(ts, type, from->lexemes + payload);
+	}
+	add_token(ts, type, payload, from->offsets[index]);
+
+	return type;
+}
+
+static int is_reserved(TokenType type)
+{
+	return (type >= TOK_ARRAY && type <= TOK_WHILE)
+		|| type == TOK_AND || type == TOK_OR || type == TOK_MOD;
+}
+
+/**
+ * Returns the index of the lexeme of a reserved word, which is only stored the
+ * first time the word is seen.
+ */
+static unsigned int keyword_lexeme(TokenStream *ts, TokenType type,
+		const char *lexeme)
+{
+	if (ts->keywords[type] == NO_LEXEME) {
+		ts->keywords[type] = add_lexeme(ts, lexeme);
+	}
+	return ts->keywords[type];
+}
+
+static unsigned int add_lexeme(TokenStream *ts, const char *lexeme)
+{
+	size_t len, index;
+
+	len = strlen(lexeme) + 1;
+	if (ts->lexlen + len > ts->maxlex) {
+		ts->maxlex *= 2;
+		ts->lexemes = erealloc(ts->lexemes, ts->maxlex);
+	}
+
+	index = ts->lexlen;
+	memcpy(ts->lexemes + index, lexeme, len);
+	ts->lexlen += len;
+
+	return index;
+}
+
+static unsigned int add_string(TokenStream *ts, StrSlice *string)
+{
+	if (ts->nstrings == ts->maxstrings) {
+		ts->maxstrings *= 2;
+		ts->strings = erealloc(ts->strings,
+				ts->maxstrings * sizeof(StrSlice));
+	}
+
+	ts->strings[ts->nstrings] = *string;
+	return ts->nstrings++;
+}
+
+static void add_token(TokenStream *ts, TokenType type, unsigned int payload,
+		unsigned int offset)
+{
+	if (ts->ntokens == ts->maxtokens) {
+		ts->maxtokens *= 2;
+		ts->types = erealloc(ts->types, ts->maxtokens * sizeof(unsigned char));
+		ts->payloads = erealloc(ts->payloads,
+				ts->maxtokens * sizeof(unsigned int));
+		ts->offsets = erealloc(ts->offsets,
+				ts->maxtokens * sizeof(unsigned int));
+	}
+
+	ts->types[ts->ntokens] = type;
+	ts->payloads[ts->ntokens] = payload;
+	ts->offsets[ts->ntokens] = offset;
+	ts->ntokens++;
+}
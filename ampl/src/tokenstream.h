@@ -0,0 +1,90 @@
+/**
+ * @file    tokenstream.h
+ * @brief   A compact, pre-scanned token stream for AMPL-2020.
+ *
+ * The token stream holds every token of a source file in a structure of
+ * arrays: a one-byte type, a four-byte payload, and a four-byte source offset
+ * per token.  The payload is the value of a numeric literal, the intern ID of
+ * an identifier, or an index into the lexeme or string tables of the stream.
+ * The parser walks an index over the stream instead of pulling tokens from the
+ * scanner one at a time, which keeps the hot loop cache-resident and makes
+ * arbitrary lookahead cheap.
+ */
+
+#ifndef TOKENSTREAM_H
+#define TOKENSTREAM_H
+
+#include "scanner.h"
+#include "token.h"
+
+/** the container structure for a token stream */
+typedef struct tokenstream TokenStream;
+
+/**
+ * Initialises an empty token stream.
+ *
+ * @return      a pointer to the token stream container structure
+ */
+TokenStream *ts_init(void);
+
+/**
+ * Scans the source file of the specified scanner up to and including the
+ * end-of-file token, and appends every token to the specified stream.  Since
+ * the whole file is scanned up front, lexical errors are reported before any
+ * syntax error.  Large mapped sources are scanned in chunks on several
+ * threads, with the same result as a sequential scan.
+ *
+ * @param[in]   ts
+ *     the token stream to fill
+ * @param[in]   sc
+ *     the scanner over the source file
+ */
+void ts_scan(TokenStream *ts, Scanner *sc);
+
+/**
+ * Returns the number of tokens in the specified stream, including the
+ * end-of-file token.
+ *
+ * @param[in]   ts
+ *     the token stream
+ * @return      the number of tokens in the stream
+ */
+unsigned int ts_length(TokenStream *ts);
+
+/**
+ * Returns the type of the token at the specified index, which may be anywhere
+ * in the stream.  Indices past the end refer to the end-of-file token.
+ *
+ * @param[in]   ts
+ *     the token stream
+ * @param[in]   index
+ *     the index of the token
+ * @return      the type of the token
+ */
+TokenType ts_type(TokenStream *ts, unsigned int index);
+
+/**
+ * Copies the token at the specified index into the specified token, and sets
+ * the global source position to where the scanner would have left it after
+ * reading that token.  Indices past the end refer to the end-of-file token.
+ *
+ * @param[in]   ts
+ *     the token stream
+ * @param[in]   index
+ *     the index of the token
+ * @param[out]  token
+ *     the token to fill in
+ */
+void ts_get_token(TokenStream *ts, unsigned int index, Token *token);
+
+/**
+ * Frees the space associated with the specified token stream.  String
+ * literals handed out by <code>ts_get_token</code> refer to the source text,
+ * and remain valid until the scanner is released.
+ *
+ * @param[in]   ts
+ *     the token stream to free
+ */
+void ts_free(TokenStream *ts);
+
+#endif /* TOKENSTREAM_H */
@@ -0,0 +1,294 @@
+/**
+ * @file    typedtable.h
+ * @brief   A hash table template, instantiated for specific key and value
+ *          types.
+ *
+ * Where <code>HashTab</code> stores <code>void</code> pointers and calls its
+ * hash and comparison functions through pointers, an instantiation of this
+ * template stores keys and values by value, and its hash and equality
+ * functions, which may be macros, are expanded in place.  For example,
+ *
+ *     #define ID_EQ(a, b) ((a) == (b))
+ *     TYPED_TABLE(IdTab, idtab, char *, IDprop *, intern_hash, ID_EQ)
+ *
+ * defines the type <code>IdTab</code> and the functions
+ * <code>idtab_init</code>, <code>idtab_insert</code>,
+ * <code>idtab_reserve</code>, <code>idtab_search</code>,
+ * <code>idtab_delete</code>, <code>idtab_clear</code>,
+ * <code>idtab_foreach</code>, <code>idtab_stats</code> and
+ * <code>idtab_free</code>, all static, and documented with their generic names
+ * below.
+ *
+ * The table is open-addressed with linear probing over a power-of-two number
+ * of slots, and keeps the full hash of every entry, so that most mismatches are
+ * rejected without calling the equality function.  A hash of zero marks an
+ * empty slot; a key that hashes to zero is stored with a hash of one instead.
+ * Deletion shifts the entries that follow back, so that no tombstones are
+ * left.  No memory is allocated until the first insertion.
+ */
+
+#ifndef TYPED_TABLE_H
+#define TYPED_TABLE_H
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "boolean.h"
+#include "hashtable.h"
+
+/** the number of slots allocated on the first insertion */
+#define TT_INITIAL_CAPACITY 16
+
+/** the largest maximum load factor, and the default */
+#define TT_MAX_LOADFACTOR 0.875f
+
+/**
+ * Defines a hash table type and its functions.
+ *
+ * @param[in]   type
+ *     the name of the table type
+ * @param[in]   prefix
+ *     the prefix of the function names
+ * @param[in]   K
+ *     the key type
+ * @param[in]   V
+ *     the value type
+ * @param[in]   hash
+ *     a function or macro that maps a key to an <code>unsigned int</code>
+ * @param[in]   eq
+ *     a function or macro that returns nonzero if two keys are equal
+ */
+#define TYPED_TABLE(type, prefix, K, V, hash, eq)                             \
+                                                                              \
+typedef struct {                                                              \
+	unsigned int  capacity;     /*<< the number of slots, or 0          */    \
+	unsigned int  shift;        /*<< 32 less log2 of the capacity       */    \
+	unsigned int  num_entries;  /*<< the number of entries              */    \
+	unsigned int  max_entries;  /*<< the entries that force a resize    */    \
+	float         max_loadfactor;                                             \
+	unsigned int *hashes;       /*<< the full hashes, 0 for empty slots */    \
+	K            *keys;         /*<< the keys, by value                 */    \
+	V            *values;       /*<< the values, by value               */    \
+	unsigned int  rehashes;     /*<< the number of resizes              */    \
+	unsigned long hits;         /*<< the number of successful searches  */    \
+	unsigned long misses;       /*<< the number of failed searches      */    \
+} type;                                                                       \
+                                                                              \
+/* Initialises an empty table with the specified maximum load factor; values  \
+ * outside (0, TT_MAX_LOADFACTOR) are taken as TT_MAX_LOADFACTOR. */          \
+static inline void prefix##_init(type *t, float loadfactor)                   \
+{                                                                             \
+	memset(t, 0, sizeof(type));                                               \
+	t->max_loadfactor = (loadfactor > 0.0f && loadfactor < TT_MAX_LOADFACTOR) \
+		? loadfactor : TT_MAX_LOADFACTOR;                                     \
+}                                                                             \
+                                                                              \
+static inline unsigned int prefix##_hash(K key)                               \
+{                                                                             \
+	unsigned int hv = hash(key);                                              \
+                                                                              \
+	return hv ? hv : 1;                                                       \
+}                                                                             \
+                                                                              \
+/* Returns the slot of the key, or the empty slot where it would go. */       \
+static inline unsigned int prefix##_slot(type *t, K key, unsigned int h)      \
+{                                                                             \
+	unsigned int i, mask = t->capacity - 1;                                   \
+                                                                              \
+	for (i = (h * 0x9e3779b9u) >> t->shift; t->hashes[i] != 0;                \
+			i = (i + 1) & mask) {                                             \
+		if (t->hashes[i] == h && eq(t->keys[i], key)) {                       \
+			break;                                                            \
+		}                                                                     \
+	}                                                                         \
+                                                                              \
+	return i;                                                                 \
+}                                                                             \
+                                                                              \
+/* Moves the entries to a new array of the specified power-of-two number of   \
+ * slots; returns FALSE, leaving the table as it was, if there is no memory. */\
+static inline Boolean prefix##_resize(type *t, unsigned int capacity)         \
+{                                                                             \
+	type old = *t;                                                            \
+	unsigned int i, j, shift;                                                 \
+	char *block;                                                              \
+                                                                              \
+	for (shift = 32; (1u << (32 - shift)) < capacity; shift--) {              \
+	}                                                                         \
+	if (!(block = malloc((size_t) capacity                                    \
+					* (sizeof(K) + sizeof(V) + sizeof(unsigned int))))) {     \
+		return FALSE;                                                         \
+	}                                                                         \
+	t->keys = (K *) block;                                                    \
+	t->values = (V *) (block + capacity * sizeof(K));                         \
+	t->hashes = (unsigned int *) (block + capacity                            \
+			* (sizeof(K) + sizeof(V)));                                       \
+	memset(t->hashes, 0, capacity * sizeof(unsigned int));                    \
+	t->capacity = capacity;                                                   \
+	t->shift = shift;                                                         \
+	t->max_entries = (unsigned int) (capacity * t->max_loadfactor);           \
+                                                                              \
+	for (i = 0; i < old.capacity; i++) {                                      \
+		if (old.hashes[i] != 0) {                                             \
+			j = prefix##_slot(t, old.keys[i], old.hashes[i]);                 \
+			t->hashes[j] = old.hashes[i];                                     \
+			t->keys[j] = old.keys[i];                                         \
+			t->values[j] = old.values[i];                                     \
+		}                                                                     \
+	}                                                                         \
+	if (old.capacity > 0) {                                                   \
+		free(old.keys);                                                       \
+		t->rehashes++;                                                        \
+	}                                                                         \
+                                                                              \
+	return TRUE;                                                              \
+}                                                                             \
+                                                                              \
+/* Associates the key with the value; see ht_insert. */                       \
+static inline int prefix##_insert(type *t, K key, V value)                    \
+{                                                                             \
+	unsigned int h = prefix##_hash(key), i;                                   \
+                                                                              \
+	if (t->num_entries >= t->max_entries                                      \
+			&& !prefix##_resize(t, t->capacity                                \
+				? t->capacity * 2 : TT_INITIAL_CAPACITY)) {                   \
+		return HASH_TABLE_NO_SPACE_FOR_NODE;                                  \
+	}                                                                         \
+	if (t->hashes[i = prefix##_slot(t, key, h)] != 0) {                       \
+		return HASH_TABLE_KEY_VALUE_PAIR_EXISTS;                              \
+	}                                                                         \
+	t->hashes[i] = h;                                                         \
+	t->keys[i] = key;                                                         \
+	t->values[i] = value;                                                     \
+	t->num_entries++;                                                         \
+                                                                              \
+	return EXIT_SUCCESS;                                                      \
+}                                                                             \
+                                                                              \
+/* Makes room for n entries beyond those held; see ht_reserve. */\
+static inline int prefix##_reserve(type *t, unsigned int n)                   \
+{                                                                             \
+	unsigned int capacity = TT_INITIAL_CAPACITY;                              \
+                                                                              \
+	n = (t->num_entries > UINT_MAX - n) ? UINT_MAX : t->num_entries + n;      \
+	while ((unsigned int) (capacity * t->max_loadfactor) < n                  \
+			&& capacity <= UINT_MAX / 4) {                                    \
+		capacity *= 2;                                                        \
+	}                                                                         \
+	if (capacity > t->capacity && !prefix##_resize(t, capacity)) {            \
+		return HASH_TABLE_NO_SPACE_FOR_NODE;                                  \
+	}                                                                         \
+                                                                              \
+	return EXIT_SUCCESS;                                                      \
+}                                                                             \
+                                                                              \
+/* Copies the value of the key to *value; see ht_search. */                   \
+static inline Boolean prefix##_search(type *t, K key, V *value)               \
+{                                                                             \
+	unsigned int i;                                                           \
+                                                                              \
+	if (t->num_entries > 0                                                    \
+			&& t->hashes[i = prefix##_slot(t, key, prefix##_hash(key))]) {    \
+		*value = t->values[i];                                                \
+		t->hits++;                                                            \
+		return TRUE;                                                          \
+	}                                                                         \
+                                                                              \
+	t->misses++;                                                              \
+	return FALSE;                                                             \
+}                                                                             \
+                                                                              \
+/* Removes the key, copying its value to *value if value is not NULL; see     \
+ * ht_delete. */                                                              \
+static inline Boolean prefix##_delete(type *t, K key, V *value)               \
+{                                                                             \
+	unsigned int i, j, home, mask = t->capacity - 1;                          \
+                                                                              \
+	if (t->num_entries == 0                                                   \
+			|| !t->hashes[i = prefix##_slot(t, key, prefix##_hash(key))]) {   \
+		return FALSE;                                                         \
+	}                                                                         \
+	if (value) {                                                              \
+		*value = t->values[i];                                                \
+	}                                                                         \
+                                                                              \
+	/* shift back every entry of the run that may not be found otherwise */   \
+	for (j = (i + 1) & mask; t->hashes[j] != 0; j = (j + 1) & mask) {         \
+		home = (t->hashes[j] * 0x9e3779b9u) >> t->shift;                      \
+		if (((j - home) & mask) >= ((j - i) & mask)) {                        \
+			t->hashes[i] = t->hashes[j];                                      \
+			t->keys[i] = t->keys[j];                                          \
+			t->values[i] = t->values[j];                                      \
+			i = j;                                                            \
+		}                                                                     \
+	}                                                                         \
+	t->hashes[i] = 0;                                                         \
+	t->num_entries--;                                                         \
+                                                                              \
+	return TRUE;                                                              \
+}                                                                             \
+                                                                              \
+/* Removes all entries, but keeps the slots for reuse. */                     \
+static inline void prefix##_clear(type *t)                                    \
+{                                                                             \
+	if (t->num_entries > 0) {                                                 \
+		memset(t->hashes, 0, t->capacity * sizeof(unsigned int));             \
+		t->num_entries = 0;                                                   \
+	}                                                                         \
+}                                                                             \
+                                                                              \
+/* Steps through the entries; see ht_foreach. */                              \
+static inline Boolean prefix##_foreach(type *t, unsigned int *cursor, K *key, \
+		V *value)                                                             \
+{                                                                             \
+	for (; *cursor < t->capacity; (*cursor)++) {                              \
+		if (t->hashes[*cursor] != 0) {                                        \
+			*key = t->keys[*cursor];                                          \
+			*value = t->values[(*cursor)++];                                  \
+			return TRUE;                                                      \
+		}                                                                     \
+	}                                                                         \
+                                                                              \
+	return FALSE;                                                             \
+}                                                                             \
+                                                                              \
+/* Takes a snapshot of the table; probe lengths are counted in slots. */      \
+static inline void prefix##_stats(type *t, HTstats *stats)                    \
+{                                                                             \
+	unsigned int i, n, mask = t->capacity - 1;                                \
+	unsigned long total = 0;                                                  \
+                                                                              \
+	memset(stats, 0, sizeof(HTstats));                                        \
+	stats->entries = t->num_entries;                                          \
+	stats->capacity = t->capacity;                                            \
+	stats->loadfactor = t->capacity                                           \
+		? (float) t->num_entries / t->capacity : 0.0f;                        \
+	stats->rehashes = t->rehashes;                                            \
+	stats->bytes = sizeof(type) + (size_t) t->capacity                        \
+		* (sizeof(K) + sizeof(V) + sizeof(unsigned int));                     \
+	stats->hits = t->hits;                                                    \
+	stats->misses = t->misses;                                                \
+	for (i = 0; i < t->capacity; i++) {                                       \
+		if (t->hashes[i] != 0) {                                              \
+			n = ((i - ((t->hashes[i] * 0x9e3779b9u) >> t->shift)) & mask) + 1; \
+			total += n;                                                       \
+			if (n > stats->max_probe) {                                       \
+				stats->max_probe = n;                                         \
+			}                                                                 \
+			stats->probes[(n < HT_STATS_PROBES ? n : HT_STATS_PROBES) - 1]++; \
+		}                                                                     \
+	}                                                                         \
+	stats->mean_probe = t->num_entries                                        \
+		? (float) total / t->num_entries : 0.0f;                              \
+}                                                                             \
+                                                                              \
+/* Releases the slots; the keys and values are the caller's to release. */    \
+static inline void prefix##_free(type *t)                                     \
+{                                                                             \
+	if (t->capacity > 0) {                                                    \
+		free(t->keys);                                                        \
+	}                                                                         \
+	memset(t, 0, sizeof(type));                                               \
+}
+
+#endif /* TYPED_TABLE_H */